@@ -0,0 +1,207 @@
+/*
+ * attrib.c - Per-instruction cache statistics
+ *
+ * Lackey writes an I record for every instruction before the data
+ * records it makes, so the last I address seen is the pc of each data
+ * access. The counters for each pc live in an open addressing table
+ * that doubles when half full; the report sorts the entries by misses.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "attrib.h"
+
+/* Longest command line built for addr2line */
+#define ADDR2LINE_CMD 8192
+
+typedef struct {
+    unsigned long long pc;
+    unsigned long hits, misses, evictions;
+} pc_stat;
+
+struct attrib {
+    pc_stat *slot;
+    unsigned long mask;         /* table size - 1 */
+    unsigned long used;
+    int has_zero;               /* pc 0 is the empty key, kept apart */
+    pc_stat zero;
+};
+
+attrib_t *attrib_new(void)
+{
+    attrib_t *a = calloc(1, sizeof(attrib_t));
+
+    if (a == NULL)
+        return NULL;
+    a->mask = 1023;
+    if ((a->slot = calloc(a->mask + 1, sizeof(pc_stat))) == NULL) {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+void attrib_free(attrib_t *a)
+{
+    free(a->slot);
+    free(a);
+}
+
+static inline unsigned long pc_slot(unsigned long long pc, unsigned long mask)
+{
+    return (unsigned long)((pc * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+/*
+ * grow - Double the table and reinsert every entry
+ */
+static int grow(attrib_t *a)
+{
+    unsigned long mask = 2 * a->mask + 1, i, h;
+    pc_stat *slot = calloc(mask + 1, sizeof(pc_stat));
+
+    if (slot == NULL)
+        return -1;
+    for (i = 0; i <= a->mask; i++) {
+        if (a->slot[i].pc == 0)
+            continue;
+        for (h = pc_slot(a->slot[i].pc, mask); slot[h].pc; h = (h + 1) & mask)
+            ;
+        slot[h] = a->slot[i];
+    }
+    free(a->slot);
+    a->slot = slot;
+    a->mask = mask;
+    return 0;
+}
+
+int attrib_count(attrib_t *a, unsigned long long pc, int result)
+{
+    unsigned long h;
+    pc_stat *e;
+
+    if (pc == 0) {
+        e = &a->zero;
+        a->has_zero = 1;
+    }
+    else {
+        for (h = pc_slot(pc, a->mask); a->slot[h].pc && a->slot[h].pc != pc;)
+            h = (h + 1) & a->mask;
+        e = &a->slot[h];
+        if (e->pc == 0) {
+            if (2 * (a->used + 1) > a->mask) {
+                if (grow(a) < 0)
+                    return -1;
+                return attrib_count(a, pc, result);
+            }
+            e->pc = pc;
+            a->used++;
+        }
+    }
+    if (result == CACHE_HIT)
+        e->hits++;
+    else {
+        e->misses++;
+        if (result == CACHE_EVICT)
+            e->evictions++;
+    }
+    return 0;
+}
+
+/* Most misses first, then most evictions, then lowest pc */
+static int cmp_stats(const void *x, const void *y)
+{
+    const pc_stat *a = x, *b = y;
+
+    if (a->misses != b->misses)
+        return a->misses < b->misses ? 1 : -1;
+    if (a->evictions != b->evictions)
+        return a->evictions < b->evictions ? 1 : -1;
+    return (a->pc > b->pc) - (a->pc < b->pc);
+}
+
+unsigned long long attrib_load_base(const char *binary)
+{
+    unsigned char hdr[18];
+    FILE *fp = fopen(binary, "rb");
+    size_t n;
+
+    if (fp == NULL)
+        return 0;
+    n = fread(hdr, 1, sizeof(hdr), fp);
+    fclose(fp);
+    /* e_type 3 (ET_DYN) marks a PIE; the field is little endian on x86 */
+    if (n == sizeof(hdr) && memcmp(hdr, "\177ELF", 4) == 0 &&
+        hdr[16] == 3 && hdr[17] == 0)
+        return ATTRIB_PIE_BASE;
+    return 0;
+}
+
+/*
+ * symbolize - Fill loc[i] with "function file:line" for each stat,
+ *     running addr2line once for all of them. Leaves loc alone on failure.
+ */
+static void symbolize(const pc_stat *st, int n, const char *binary,
+                      unsigned long long base, char (*loc)[128])
+{
+    char cmd[ADDR2LINE_CMD], func[256], line[512], *file, *nl;
+    int i, len;
+    FILE *fp;
+
+    if (strchr(binary, '\''))
+        return;
+    len = snprintf(cmd, sizeof(cmd), "addr2line -f -C -e '%s'", binary);
+    for (i = 0; i < n && len < (int)sizeof(cmd) - 24; i++)
+        len += snprintf(cmd + len, sizeof(cmd) - len, " %llx",
+                        st[i].pc - base);
+    n = i;
+    if ((fp = popen(cmd, "r")) == NULL)
+        return;
+    for (i = 0; i < n && fgets(func, sizeof(func), fp) &&
+                fgets(line, sizeof(line), fp); i++) {
+        if ((nl = strchr(func, '\n')))
+            *nl = '\0';
+        if ((nl = strchr(line, '\n')))
+            *nl = '\0';
+        /* Keep the file name, not the build directory */
+        file = strrchr(line, '/') ? strrchr(line, '/') + 1 : line;
+        snprintf(loc[i], sizeof(loc[i]), "%.60s %.60s", func, file);
+    }
+    pclose(fp);
+}
+
+void attrib_print(attrib_t *a, int top, const char *binary,
+                  unsigned long long base)
+{
+    unsigned long i, n = 0;
+    pc_stat *st = malloc(sizeof(pc_stat) * (a->used + 1));
+    char (*loc)[128];
+    int k;
+
+    if (st == NULL)
+        return;
+    for (i = 0; i <= a->mask; i++)
+        if (a->slot[i].pc)
+            st[n++] = a->slot[i];
+    if (a->has_zero)
+        st[n++] = a->zero;
+    qsort(st, n, sizeof(pc_stat), cmp_stats);
+    if (top > 0 && (unsigned long)top < n)
+        n = top;
+    if ((loc = calloc(n ? n : 1, sizeof(*loc))) == NULL) {
+        free(st);
+        return;
+    }
+    if (binary)
+        symbolize(st, (int)n, binary, base, loc);
+
+    printf("%18s %12s %12s %12s%s\n", "pc", "hits", "misses", "evictions",
+           binary ? "  location" : "");
+    for (k = 0; k < (int)n; k++)
+        printf("%18llx %12lu %12lu %12lu%s%s\n", st[k].pc, st[k].hits,
+               st[k].misses, st[k].evictions, binary ? "  " : "", loc[k]);
+    free(loc);
+    free(st);
+}
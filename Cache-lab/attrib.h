@@ -0,0 +1,38 @@
+/*
+ * attrib.h - Prototypes for attributing cache hits, misses and
+ *     evictions to the instruction that made each access
+ */
+
+#ifndef CACHELAB_ATTRIB_H
+#define CACHELAB_ATTRIB_H
+
+/* Where valgrind maps a position independent executable on Linux */
+#define ATTRIB_PIE_BASE 0x108000ULL
+
+/* Per-instruction counters; the layout is private to attrib.c */
+typedef struct attrib attrib_t;
+
+/* Allocate an empty table. Returns NULL if out of memory. */
+attrib_t *attrib_new(void);
+
+/* Release a table returned by attrib_new */
+void attrib_free(attrib_t *a);
+
+/*
+ * attrib_count - Charge one access outcome (CACHE_HIT, CACHE_MISS or
+ *     CACHE_EVICT) to the instruction at pc. Returns -1 if out of memory.
+ */
+int attrib_count(attrib_t *a, unsigned long long pc, int result);
+
+/*
+ * attrib_print - Print the top instructions by misses (all if top is 0).
+ *     If binary is not NULL, each pc less base is resolved to a function
+ *     and source line with addr2line.
+ */
+void attrib_print(attrib_t *a, int top, const char *binary,
+                  unsigned long long base);
+
+/* Load address valgrind gives binary: ATTRIB_PIE_BASE if it is PIE, else 0 */
+unsigned long long attrib_load_base(const char *binary);
+
+#endif /* CACHELAB_ATTRIB_H */
@@ -0,0 +1,243 @@
+/*
+ * cache-bench.c - Compare the simulation speed of the structure-of-arrays
+ *     cache in cache.c against the original csim layout (one malloc'd
+ *     array of {tag, v, recent} lines per set).
+ *
+ * The input trace (traces/dave.trace by default) is scaled up by
+ * replaying it many times, each copy shifted to a pseudo-random block
+ * offset inside a large footprint so that big caches see real set
+ * pressure. Both models must agree on every count.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "trace.h"
+#include "cache.h"
+
+#define DEFAULT_TRACE "traces/dave.trace"
+#define DEFAULT_REPEAT 2000000
+#define DEFAULT_FOOTPRINT (64 << 20)
+#define DEFAULT_CONFIGS "5:1:5,10:4:6,12:8:6,14:16:6,8:32:6,6:64:6"
+
+/* The csim line layout this benchmark compares against */
+typedef struct {
+    long long tag;
+    int v, recent;
+} line;
+
+typedef struct {
+    int s, E, b;
+    line **sets;
+    int count_opers;
+    unsigned long hits, misses, evictions;
+} legacy_t;
+
+static legacy_t *legacy_new(int s, int E, int b)
+{
+    legacy_t *c = calloc(1, sizeof(legacy_t));
+    int i;
+
+    c->s = s;
+    c->E = E;
+    c->b = b;
+    c->sets = malloc(sizeof(line *) * (1 << s));
+    for (i = 0; i < (1 << s); i++)
+        c->sets[i] = calloc(E, sizeof(line));
+    return c;
+}
+
+static void legacy_free(legacy_t *c)
+{
+    int i;
+
+    for (i = 0; i < (1 << c->s); i++)
+        free(c->sets[i]);
+    free(c->sets);
+    free(c);
+}
+
+/* legacy_access - the inner loop of the original csim */
+static void legacy_access(legacy_t *c, unsigned long long addr)
+{
+    unsigned set_index = ((unsigned int)addr >> c->b) & ((1u << c->s) - 1);
+    long long tag = addr >> (c->s + c->b);
+    line *set = c->sets[set_index];
+    int i, exist = 0, full = 1, evict = 0, target = 0, empty_one = 0;
+    int least_recent = c->count_opers + 1;
+
+    for (i = 0; i < c->E; ++i) {
+        if (set[i].recent < least_recent) {
+            evict = i;
+            least_recent = set[i].recent;
+        }
+        if (set[i].v && set[i].tag == tag) {
+            exist = 1;
+            target = i;
+        }
+        if (!set[i].v) {
+            full = 0;
+            if (!empty_one) empty_one = i;
+        }
+    }
+    if (exist) {
+        c->hits++;
+    }
+    else if (!full) {
+        c->misses++;
+        target = empty_one;
+        set[target].v = 1;
+        set[target].tag = tag;
+    }
+    else {
+        c->misses++;
+        c->evictions++;
+        target = evict;
+        set[evict].tag = tag;
+    }
+    set[target].recent = c->count_opers;
+    c->count_opers++;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * scale_trace - Replay the data addresses of the trace repeat times,
+ *     shifting each copy to a block aligned offset in the footprint
+ */
+static unsigned long long *scale_trace(const char *path, long repeat,
+                                       unsigned long long footprint, long *n)
+{
+    unsigned long long base[4096], off, *addrs;
+    trace_rec_t rec;
+    trace_t *trace;
+    long nbase = 0, k, i;
+
+    if ((trace = trace_open(path)) == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    while (nbase < 4096 && trace_next(trace, &rec))
+        if (rec.op != 'I')
+            base[nbase++] = rec.addr;
+    trace_close(trace);
+
+    *n = nbase * repeat;
+    if ((addrs = malloc(sizeof(unsigned long long) * (*n ? *n : 1))) == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    for (k = 0; k < repeat; k++) {
+        off = ((unsigned long long)k * 0x9E3779B97F4A7C15ULL >> 20)
+            % footprint & ~63ULL;
+        for (i = 0; i < nbase; i++)
+            addrs[k * nbase + i] = base[i] + off;
+    }
+    return addrs;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-t <tracefile>] [-n <repeat>] [-f <bytes>] "
+           "[-c <s:E:b,...>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -t <file>   Trace to scale up (default %s).\n", DEFAULT_TRACE);
+    printf("  -n <n>      Number of shifted copies (default %d).\n",
+           DEFAULT_REPEAT);
+    printf("  -f <bytes>  Footprint the copies are spread over (default %d).\n",
+           DEFAULT_FOOTPRINT);
+    printf("  -c <list>   Geometries to time (default %s).\n", DEFAULT_CONFIGS);
+}
+
+int main(int argc, char *argv[])
+{
+    char *path = DEFAULT_TRACE, *list = DEFAULT_CONFIGS;
+    unsigned long long footprint = DEFAULT_FOOTPRINT, *addrs;
+    long repeat = DEFAULT_REPEAT, n, i;
+    int c, s, E, b, len, status = 0;
+    double t0, t_old, t_new;
+    legacy_t *old;
+    cache_t *soa;
+
+    while ((c = getopt(argc, argv, "t:n:f:c:h")) != -1) {
+        switch (c) {
+        case 't':
+            path = optarg;
+            break;
+        case 'n':
+            repeat = atol(optarg);
+            break;
+        case 'f':
+            footprint = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            list = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (repeat < 1 || footprint < 64) {
+        usage(argv);
+        exit(1);
+    }
+
+    addrs = scale_trace(path, repeat, footprint, &n);
+    printf("%ld accesses (%s x %ld over %llu bytes), %s set probes\n\n",
+           n, path, repeat, footprint, cache_simd_name());
+    printf("%4s %6s %4s %14s %14s %8s\n",
+           "s", "E", "b", "legacy Macc/s", "SoA Macc/s", "speedup");
+
+    while (sscanf(list, "%d:%d:%d%n", &s, &E, &b, &len) == 3) {
+        old = legacy_new(s, E, b);
+        t0 = now_sec();
+        for (i = 0; i < n; i++)
+            legacy_access(old, addrs[i]);
+        t_old = now_sec() - t0;
+
+        if ((soa = cache_new(s, E, b, POLICY_LRU)) == NULL) {
+            fprintf(stderr, "Error: cannot allocate %d:%d:%d\n", s, E, b);
+            exit(1);
+        }
+        t0 = now_sec();
+        for (i = 0; i < n; i++)
+            cache_access(soa, addrs[i]);
+        t_new = now_sec() - t0;
+
+        printf("%4d %6d %4d %14.1f %14.1f %7.2fx\n", s, E, b,
+               n / t_old / 1e6, n / t_new / 1e6, t_old / t_new);
+        if (old->hits != soa->hits || old->misses != soa->misses ||
+            old->evictions != soa->evictions) {
+            printf("Error: counts differ (legacy %lu/%lu/%lu, SoA %lu/%lu/%lu)\n",
+                   old->hits, old->misses, old->evictions,
+                   soa->hits, soa->misses, soa->evictions);
+            status = 1;
+        }
+        legacy_free(old);
+        cache_free(soa);
+        list += len;
+        if (*list != ',')
+            break;
+        list++;
+    }
+    free(addrs);
+    return status;
+}
@@ -0,0 +1,777 @@
+/*
+ * cache.c - Set-associative cache with pluggable replacement policies
+ *
+ * Under LRU every way is stamped with a per-cache clock when it is used
+ * and the way with the smallest stamp in a set is the victim; FIFO
+ * stamps only on fill. When the 32 bit clock runs out, the stamps of
+ * each set are replaced by their ranks, which keeps the order and
+ * restarts the clock. Every policy fills an empty way, if the set has
+ * one, before it evicts a valid line.
+ *
+ * The other policies are tree pseudo-LRU, random, SRRIP and BRRIP
+ * (Jaleel et al., ISCA 2010, with 2 bit re-reference predictions), and
+ * Belady's OPT, which evicts the line whose next reference is furthest
+ * away. OPT reads the next reference of each access from an index the
+ * caller builds in one pass over the trace, so a miss costs one O(E)
+ * scan of the set rather than a search of the future trace.
+ *
+ * For associative sets the probe is done on whole masks: the tags of
+ * up to 64 ways are compared at once into a hit mask, the first empty
+ * way is the lowest clear bit of the valid word, and only a full set
+ * needs the minimum stamp. The compare and the minimum have AVX2 and
+ * SSE4.1 versions, picked once at run time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CACHE_X86 1
+#endif
+
+/* Ways below this are probed with the scalar loops */
+#define SIMD_MIN_E 16
+
+/*
+ * match_scalar - Bit i of the result is set when tags[i] == tag
+ */
+static unsigned long long match_scalar(const unsigned long long *tags, int n,
+                                       unsigned long long tag)
+{
+    unsigned long long m = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        m |= (unsigned long long)(tags[i] == tag) << i;
+    return m;
+}
+
+/*
+ * argmin_scalar - Index of the first smallest stamp
+ */
+static int argmin_scalar(const unsigned int *stamp, int n)
+{
+    unsigned int least = stamp[0];
+    int i, w = 0;
+
+    for (i = 1; i < n; i++) {
+        if (stamp[i] < least) {
+            least = stamp[i];
+            w = i;
+        }
+    }
+    return w;
+}
+
+#ifdef CACHE_X86
+__attribute__((target("avx2")))
+static unsigned long long match_avx2(const unsigned long long *tags, int n,
+                                     unsigned long long tag)
+{
+    __m256i t = _mm256_set1_epi64x((long long)tag);
+    unsigned long long m = 0;
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(tags + i));
+        m |= (unsigned long long)_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, t))) << i;
+    }
+    for (; i < n; i++)
+        m |= (unsigned long long)(tags[i] == tag) << i;
+    return m;
+}
+
+__attribute__((target("avx2")))
+static int argmin_avx2(const unsigned int *stamp, int n)
+{
+    __m256i lo = _mm256_set1_epi32(-1), v;
+    unsigned int least = ~0u, lanes[8];
+    int i, w;
+
+    for (i = 0; i + 8 <= n; i += 8)
+        lo = _mm256_min_epu32(lo, _mm256_loadu_si256((const __m256i *)(stamp + i)));
+    _mm256_storeu_si256((__m256i *)lanes, lo);
+    for (w = 0; w < 8; w++)
+        if (lanes[w] < least)
+            least = lanes[w];
+    for (; i < n; i++)
+        if (stamp[i] < least)
+            least = stamp[i];
+
+    /* First way holding the minimum */
+    v = _mm256_set1_epi32((int)least);
+    for (i = 0; i + 8 <= n; i += 8) {
+        int m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(
+            _mm256_loadu_si256((const __m256i *)(stamp + i)), v)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    for (; stamp[i] != least; i++)
+        ;
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+static unsigned long long match_sse4(const unsigned long long *tags, int n,
+                                     unsigned long long tag)
+{
+    __m128i t = _mm_set1_epi64x((long long)tag);
+    unsigned long long m = 0;
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(tags + i));
+        m |= (unsigned long long)_mm_movemask_pd(
+            _mm_castsi128_pd(_mm_cmpeq_epi64(v, t))) << i;
+    }
+    for (; i < n; i++)
+        m |= (unsigned long long)(tags[i] == tag) << i;
+    return m;
+}
+
+__attribute__((target("sse4.1")))
+static int argmin_sse4(const unsigned int *stamp, int n)
+{
+    __m128i lo = _mm_set1_epi32(-1), v;
+    unsigned int least = ~0u, lanes[4];
+    int i, w;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        lo = _mm_min_epu32(lo, _mm_loadu_si128((const __m128i *)(stamp + i)));
+    _mm_storeu_si128((__m128i *)lanes, lo);
+    for (w = 0; w < 4; w++)
+        if (lanes[w] < least)
+            least = lanes[w];
+    for (; i < n; i++)
+        if (stamp[i] < least)
+            least = stamp[i];
+
+    v = _mm_set1_epi32((int)least);
+    for (i = 0; i + 4 <= n; i += 4) {
+        int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i *)(stamp + i)), v)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    for (; stamp[i] != least; i++)
+        ;
+    return i;
+}
+#endif /* CACHE_X86 */
+
+/* Probe level in use: 0 scalar, 1 SSE4.1, 2 AVX2; -1 until chosen */
+static int simd_level = -1;
+
+/*
+ * pick_simd - Choose the probe level from CSIM_SIMD or the CPU
+ */
+static void pick_simd(void)
+{
+    const char *env = getenv("CSIM_SIMD");
+
+    simd_level = 0;
+#ifdef CACHE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        simd_level = 2;
+    else if (__builtin_cpu_supports("sse4.1"))
+        simd_level = 1;
+    if (env && strcmp(env, "scalar") == 0)
+        simd_level = 0;
+    else if (env && strcmp(env, "sse4") == 0 && simd_level >= 1)
+        simd_level = 1;
+#else
+    (void)env;
+#endif
+}
+
+/*
+ * cache_simd_name - Name of the set probes cache_new hands out
+ */
+const char *cache_simd_name(void)
+{
+    static const char *names[] = {"scalar", "sse4", "avx2"};
+
+    if (simd_level < 0)
+        pick_simd();
+    return names[simd_level];
+}
+
+static const char *policy_names[NUM_POLICIES] = {
+    "lru", "fifo", "random", "plru", "srrip", "brrip", "opt"
+};
+
+/*
+ * cache_policy - Look up a policy by name
+ */
+int cache_policy(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_POLICIES; i++)
+        if (strcmp(name, policy_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+/*
+ * cache_policy_name - Name of a policy number
+ */
+const char *cache_policy_name(int policy)
+{
+    return policy_names[policy];
+}
+
+/* Rows and table entries a sparse cache starts with */
+#define SPARSE_ROWS 1024
+
+/*
+ * grow_array - Resize *p from old to n elements of size bytes, zeroing
+ *     the new ones. The first allocation uses calloc, whose pages the
+ *     kernel zeroes on first touch, so a big dense cache costs nothing
+ *     up front. Returns -1 if out of memory, leaving *p in place.
+ */
+static int grow_array(void **p, size_t old, size_t n, size_t size, int zero)
+{
+    void *q;
+
+    if (old == 0) {
+        if ((q = zero ? calloc(n, size) : malloc(n * size)) == NULL)
+            return -1;
+        free(*p);
+    }
+    else {
+        if ((q = realloc(*p, n * size)) == NULL)
+            return -1;
+        if (zero)
+            memset((char *)q + old * size, 0, (n - old) * size);
+    }
+    *p = q;
+    return 0;
+}
+
+/*
+ * alloc_rows - Size the line arrays for rows rows, with every new row
+ *     empty. Returns -1 if out of memory.
+ */
+static int alloc_rows(cache_t *c, size_t rows)
+{
+    size_t E = c->E, vw = c->vwords, old = c->maxrows;
+
+    if (grow_array((void **)&c->tags, old * E, rows * E,
+                   sizeof(unsigned long long), 0) < 0 ||
+        grow_array((void **)&c->valid, old * vw, rows * vw,
+                   sizeof(unsigned long long), 1) < 0 ||
+        grow_array((void **)&c->dirty, old * vw, rows * vw,
+                   sizeof(unsigned long long), 1) < 0 ||
+        grow_array((void **)&c->stamp, old * E, rows * E,
+                   sizeof(unsigned int), 1) < 0 ||
+        (c->policy == POLICY_OPT &&
+         grow_array((void **)&c->next, old * E, rows * E,
+                    sizeof(unsigned long long), 0) < 0))
+        return -1;
+    c->maxrows = rows;
+    return 0;
+}
+
+/*
+ * alloc_table - Allocate an empty sparse set table of size entries
+ */
+static int alloc_table(cache_t *c, size_t size)
+{
+    free(c->set_key);
+    free(c->set_row);
+    c->set_key = malloc(sizeof(unsigned long long) * size);
+    c->set_row = malloc(sizeof(size_t) * size);
+    if (!c->set_key || !c->set_row)
+        return -1;
+    memset(c->set_row, 0xff, sizeof(size_t) * size);
+    c->set_mask = size - 1;
+    return 0;
+}
+
+/*
+ * create - Allocate an empty cache, dense or sparse
+ */
+static cache_t *create(int s, int E, int b, int policy, int sparse)
+{
+    cache_t *c;
+
+    if (s < 0 || s > CACHE_MAX_S || b < 0 || b > 63 || s + b > 64 ||
+        E < 1 || policy < 0 || policy >= NUM_POLICIES)
+        return NULL;
+    if (policy == POLICY_PLRU && (E & (E - 1)))
+        return NULL;
+    if ((c = calloc(1, sizeof(cache_t))) == NULL)
+        return NULL;
+    c->s = s;
+    c->E = E;
+    c->b = b;
+    c->policy = policy;
+    c->sparse = sparse;
+    c->rng = 0x2545F4914F6CDD1DULL;
+    c->vwords = (E + 63) / 64;
+    if (simd_level < 0)
+        pick_simd();
+    c->match = match_scalar;
+    c->argmin = argmin_scalar;
+#ifdef CACHE_X86
+    if (E >= SIMD_MIN_E && simd_level == 2) {
+        c->match = match_avx2;
+        c->argmin = argmin_avx2;
+    }
+    else if (E >= SIMD_MIN_E && simd_level == 1) {
+        c->match = match_sse4;
+        c->argmin = argmin_sse4;
+    }
+#endif
+    if (sparse) {
+        if (alloc_rows(c, SPARSE_ROWS) < 0 ||
+            alloc_table(c, 2 * SPARSE_ROWS) < 0) {
+            cache_free(c);
+            return NULL;
+        }
+    }
+    else {
+        if (alloc_rows(c, (size_t)1 << s) < 0) {
+            cache_free(c);
+            return NULL;
+        }
+        c->nrows = c->maxrows;
+    }
+    return c;
+}
+
+/*
+ * cache_new - Allocate 2^s empty sets of E ways
+ */
+cache_t *cache_new(int s, int E, int b, int policy)
+{
+    /* Dense while the line arrays stay small (this also keeps E << s in range) */
+    int sparse = s > CACHE_MAX_S || (size_t)E > CACHE_DENSE_LINES >> s;
+
+    return create(s, E, b, policy, sparse);
+}
+
+/*
+ * cache_new_sparse - Allocate a cache whose sets get rows on first use
+ */
+cache_t *cache_new_sparse(int s, int E, int b, int policy)
+{
+    return create(s, E, b, policy, 1);
+}
+
+/*
+ * cache_free - Free the line arrays and the cache itself
+ */
+void cache_free(cache_t *c)
+{
+    free(c->tags);
+    free(c->valid);
+    free(c->dirty);
+    free(c->stamp);
+    free(c->next);
+    free(c->set_key);
+    free(c->set_row);
+    free(c);
+}
+
+/*
+ * cache_flush - Invalidate every line and restart the policy state
+ */
+void cache_flush(cache_t *c)
+{
+    memset(c->valid, 0, sizeof(unsigned long long) * c->nrows * c->vwords);
+    memset(c->dirty, 0, sizeof(unsigned long long) * c->nrows * c->vwords);
+    memset(c->stamp, 0, sizeof(unsigned int) * c->nrows * c->E);
+    if (c->sparse) {
+        /* Rows are handed out again from the first */
+        memset(c->set_row, 0xff, sizeof(size_t) * (c->set_mask + 1));
+        c->nrows = 0;
+    }
+    c->written = 0;
+    c->clock = 0;
+}
+
+/*
+ * out_of_memory - A sparse cache could not grow; the simulation cannot
+ *     go on with a set missing, so give up the way sdist's xmalloc does
+ */
+static void out_of_memory(void)
+{
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+}
+
+/* Slot of a set index in a sparse table of mask+1 entries */
+static inline size_t set_hash(unsigned long long set, size_t mask)
+{
+    return (size_t)((set * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+/*
+ * sparse_row - Row of a set in a sparse cache. On its first use the set
+ *     gets a new row (growing the arrays and the table) if create is
+ *     set, else the result is -1.
+ */
+static size_t sparse_row(cache_t *c, unsigned long long set, int create)
+{
+    size_t h, i, row, omask;
+    unsigned long long *okey;
+    size_t *orow;
+
+    for (h = set_hash(set, c->set_mask); c->set_row[h] != (size_t)-1;
+         h = (h + 1) & c->set_mask)
+        if (c->set_key[h] == set)
+            return c->set_row[h];
+    if (!create)
+        return (size_t)-1;
+    if (c->nrows == c->maxrows && alloc_rows(c, 2 * c->maxrows) < 0)
+        out_of_memory();
+    row = c->nrows++;
+    c->set_key[h] = set;
+    c->set_row[h] = row;
+    /* Keep the table at most half full */
+    if (2 * c->nrows > c->set_mask) {
+        okey = c->set_key;
+        orow = c->set_row;
+        omask = c->set_mask;
+        c->set_key = NULL;
+        c->set_row = NULL;
+        if (alloc_table(c, 2 * (omask + 1)) < 0)
+            out_of_memory();
+        for (i = 0; i <= omask; i++) {
+            if (orow[i] == (size_t)-1)
+                continue;
+            for (h = set_hash(okey[i], c->set_mask); c->set_row[h] != (size_t)-1;)
+                h = (h + 1) & c->set_mask;
+            c->set_key[h] = okey[i];
+            c->set_row[h] = orow[i];
+        }
+        free(okey);
+        free(orow);
+    }
+    return row;
+}
+
+/*
+ * cache_set_future - Attach the next-reference index used by OPT
+ */
+void cache_set_future(cache_t *c, const unsigned long long *future)
+{
+    c->future = future;
+}
+
+/*
+ * renumber - Replace the stamps of every set by their rank within the
+ *     set, so the clock can restart just above E. Each set is ordered by
+ *     an insertion sort of its own stamps, which keeps no state outside
+ *     the cache, so caches on other threads may renumber at the same time.
+ */
+static void renumber(cache_t *c)
+{
+    size_t row;
+    int *order = malloc(sizeof(int) * c->E), i, j;
+    unsigned int *stamps;
+
+    for (row = 0; row < c->nrows; row++) {
+        stamps = c->stamp + row * c->E;
+        for (i = 0; i < c->E; i++) {
+            for (j = i; j > 0 && stamps[order[j - 1]] > stamps[i]; j--)
+                order[j] = order[j - 1];
+            order[j] = i;
+        }
+        for (i = 0; i < c->E; i++)
+            if (stamps[order[i]])
+                stamps[order[i]] = i + 1;
+    }
+    c->clock = c->E;
+    free(order);
+}
+
+/* Re-reference predictions: 0 = imminent, RRPV_MAX = distant */
+#define RRPV_MAX  3
+#define RRPV_LONG 2
+/* BRRIP inserts with a long rather than distant prediction 1 in 32 times */
+#define BRRIP_LONG_ODDS 32
+
+static inline unsigned long long next_random(cache_t *c)
+{
+    c->rng ^= c->rng << 13;
+    c->rng ^= c->rng >> 7;
+    c->rng ^= c->rng << 17;
+    return c->rng;
+}
+
+/*
+ * plru_touch - Point every tree node on the path to way w away from it
+ */
+static inline void plru_touch(unsigned int *node, int E, int w)
+{
+    int bit, n = 0, d;
+
+    for (bit = E >> 1; bit; bit >>= 1) {
+        d = (w & bit) != 0;
+        node[n] = !d;
+        n = 2 * n + 1 + d;
+    }
+}
+
+/*
+ * plru_victim - Follow the tree nodes from the root to a way
+ */
+static inline int plru_victim(const unsigned int *node, int E)
+{
+    int bit, n = 0, w = 0, d;
+
+    for (bit = E >> 1; bit; bit >>= 1) {
+        d = node[n] != 0;
+        w = (w << 1) | d;
+        n = 2 * n + 1 + d;
+    }
+    return w;
+}
+
+/*
+ * policy_use - Update the policy state of way w (set word offset base)
+ *     for a hit, or for a fill when fill is nonzero. ref is the index of
+ *     the access in OPT's future, or CACHE_NEVER for a CACHE_FILL, which
+ *     is not an access and has no next use to look up.
+ */
+static inline void policy_use(cache_t *c, size_t base, int w, int fill,
+                              unsigned long long ref)
+{
+    unsigned int *stamp = c->stamp + base;
+
+    switch (c->policy) {
+    case POLICY_LRU:
+        stamp[w] = ++c->clock;
+        break;
+    case POLICY_FIFO:
+        if (fill)
+            stamp[w] = ++c->clock;
+        break;
+    case POLICY_PLRU:
+        plru_touch(stamp, c->E, w);
+        break;
+    case POLICY_SRRIP:
+        stamp[w] = fill ? RRPV_LONG : 0;
+        break;
+    case POLICY_BRRIP:
+        if (!fill)
+            stamp[w] = 0;
+        else
+            stamp[w] = next_random(c) % BRRIP_LONG_ODDS ? RRPV_MAX : RRPV_LONG;
+        break;
+    case POLICY_OPT:
+        c->next[base + w] = c->future && ref != CACHE_NEVER
+                            ? c->future[ref] : CACHE_NEVER;
+        break;
+    }
+}
+
+/*
+ * policy_victim - Choose the way to evict from a full set
+ */
+static int policy_victim(cache_t *c, size_t base)
+{
+    unsigned int *stamp = c->stamp + base, most;
+    unsigned long long *next = c->next + base, far;
+    int i, w = 0, E = c->E;
+
+    switch (c->policy) {
+    case POLICY_RANDOM:
+        return (int)(next_random(c) % E);
+    case POLICY_PLRU:
+        return plru_victim(stamp, E);
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+        /* Age the whole set until some way predicts a distant reuse */
+        most = 0;
+        for (i = 0; i < E; i++) {
+            if (stamp[i] > most) {
+                most = stamp[i];
+                w = i;
+            }
+        }
+        if (most < RRPV_MAX)
+            for (i = 0; i < E; i++)
+                stamp[i] += RRPV_MAX - most;
+        return w;
+    case POLICY_OPT:
+        far = next[0];
+        for (i = 1; i < E; i++) {
+            if (next[i] > far) {
+                far = next[i];
+                w = i;
+            }
+        }
+        return w;
+    default:
+        return c->argmin(stamp, E);
+    }
+}
+
+/*
+ * evict - Count the eviction of way i of a set (stored in row), and
+ *     record it as the victim if track is set
+ */
+static inline void evict(cache_t *c, size_t set_index, size_t row, int i,
+                         int track)
+{
+    c->evictions++;
+    if (track) {
+        c->victim = (c->tags[row * c->E + i] << c->s | set_index) << c->b;
+        c->victim_dirty = 0;
+    }
+    if (c->written) {
+        c->victim_dirty = (c->dirty[row * c->vwords + (i >> 6)] >> (i & 63)) & 1;
+        c->writebacks += c->victim_dirty;
+    }
+}
+
+/*
+ * mark - Set or clear the dirty bit of way i. Until the first write
+ *     every bit is clear, so read-only simulations never touch the map.
+ */
+static inline void mark(cache_t *c, size_t row, int i, int dirty)
+{
+    unsigned long long *word, bit = 1ULL << (i & 63);
+
+    if (!dirty && !c->written)
+        return;
+    c->written = 1;
+    word = c->dirty + row * c->vwords + (i >> 6);
+    if (dirty)
+        *word |= bit;
+    else
+        *word &= ~bit;
+}
+
+/*
+ * find_way - Index of the valid way of a row holding tag, or -1
+ */
+static inline int find_way(cache_t *c, size_t row, unsigned long long tag)
+{
+    unsigned long long *tags = c->tags + row * c->E;
+    unsigned long long *valid = c->valid + row * c->vwords, m;
+    int w, n, E = c->E;
+
+    for (w = 0; w < E; w += 64) {
+        n = E - w < 64 ? E - w : 64;
+        if ((m = c->match(tags + w, n, tag) & valid[w >> 6]))
+            return w + __builtin_ctzll(m);
+    }
+    return -1;
+}
+
+/*
+ * lookup - Simulate one access to addr. Inlined into cache_access with
+ *     constant arguments, so plain reads pay nothing for the flag tests
+ *     or for recording victims.
+ */
+static inline __attribute__((always_inline))
+int lookup(cache_t *c, unsigned long long addr, int flags, int track)
+{
+    size_t set_index = cache_set(c->s, c->b, addr);
+    size_t row = c->sparse ? sparse_row(c, set_index, 1) : set_index;
+    size_t base = row * c->E;
+    unsigned long long tag = cache_tag(c->s, c->b, addr);
+    unsigned long long *tags = c->tags + base;
+    unsigned long long *valid = c->valid + row * c->vwords;
+    unsigned long long m, ref = c->refs;
+    int i, w, n, E = c->E, count = !(flags & CACHE_FILL);
+    int result = CACHE_MISS;
+
+    c->refs += count;
+    if (E == 1) {
+        /* Direct mapped: the only way is the victim under any policy */
+        if ((valid[0] & 1) && tags[0] == tag) {
+            c->hits += count;
+            if (flags & CACHE_WRITE)
+                mark(c, row, 0, 1);
+            return CACHE_HIT;
+        }
+        c->misses += count;
+        if (flags & CACHE_NOALLOC)
+            return CACHE_MISS;
+        if (valid[0] & 1) {
+            evict(c, set_index, row, 0, track);
+            result = CACHE_EVICT;
+        }
+        valid[0] = 1;
+        tags[0] = tag;
+        mark(c, row, 0, flags & CACHE_WRITE);
+        return result;
+    }
+
+    if (c->clock == ~0u)
+        renumber(c);
+    if ((i = find_way(c, row, tag)) >= 0) {
+        if (count) {
+            policy_use(c, base, i, 0, ref);
+            c->hits++;
+        }
+        if (flags & CACHE_WRITE)
+            mark(c, row, i, 1);
+        return CACHE_HIT;
+    }
+
+    /* Miss: fill the first empty way, else evict the policy's victim */
+    c->misses += count;
+    if (flags & CACHE_NOALLOC)
+        return CACHE_MISS;
+    for (i = -1, w = 0; w < E; w += 64) {
+        n = E - w < 64 ? E - w : 64;
+        m = ~valid[w >> 6] & (n == 64 ? ~0ULL : (1ULL << n) - 1);
+        if (m) {
+            i = w + __builtin_ctzll(m);
+            valid[w >> 6] |= m & -m;
+            break;
+        }
+    }
+    if (i < 0) {
+        i = policy_victim(c, base);
+        evict(c, set_index, row, i, track);
+        result = CACHE_EVICT;
+    }
+    tags[i] = tag;
+    mark(c, row, i, flags & CACHE_WRITE);
+    policy_use(c, base, i, 1, count ? ref : CACHE_NEVER);
+    return result;
+}
+
+/*
+ * cache_access - Read addr
+ */
+int cache_access(cache_t *c, unsigned long long addr)
+{
+    return lookup(c, addr, 0, 0);
+}
+
+/*
+ * cache_lookup - Access addr as flags direct
+ */
+int cache_lookup(cache_t *c, unsigned long long addr, int flags)
+{
+    return lookup(c, addr, flags, 1);
+}
+
+/*
+ * cache_invalidate - Drop the block holding addr, if any
+ */
+int cache_invalidate(cache_t *c, unsigned long long addr)
+{
+    size_t row = cache_set(c->s, c->b, addr);
+    int i;
+
+    if (c->sparse && (row = sparse_row(c, row, 0)) == (size_t)-1)
+        return -1;
+    if ((i = find_way(c, row, cache_tag(c->s, c->b, addr))) < 0)
+        return -1;
+    c->valid[row * c->vwords + (i >> 6)] &= ~(1ULL << (i & 63));
+    return c->written ? (c->dirty[row * c->vwords + (i >> 6)] >> (i & 63)) & 1 : 0;
+}
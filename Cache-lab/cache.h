@@ -0,0 +1,168 @@
+/*
+ * cache.h - Prototypes for the set-associative cache model shared by
+ *     the cache simulator modes
+ */
+
+#ifndef CACHELAB_CACHE_H
+#define CACHELAB_CACHE_H
+
+#include <stddef.h>
+#include "trace.h"
+
+/* Outcome of a single cache access */
+#define CACHE_HIT   0
+#define CACHE_MISS  1
+#define CACHE_EVICT 2   /* miss that evicted a valid line */
+
+/* Flags for cache_lookup */
+#define CACHE_WRITE   1   /* mark the line dirty */
+#define CACHE_NOALLOC 2   /* do not fill the block on a miss */
+#define CACHE_FILL    4   /* place the block without counting an access */
+
+/* Replacement policies */
+#define POLICY_LRU    0
+#define POLICY_FIFO   1
+#define POLICY_RANDOM 2
+#define POLICY_PLRU   3   /* tree pseudo-LRU, E must be a power of two */
+#define POLICY_SRRIP  4   /* static re-reference interval prediction */
+#define POLICY_BRRIP  5   /* bimodal RRIP */
+#define POLICY_OPT    6   /* Belady's optimal, needs cache_set_future */
+#define NUM_POLICIES  7
+
+/* Marks a block that is never referenced again in a future index */
+#define CACHE_NEVER (~0ULL)
+
+/*
+ * The lines are kept as a structure of arrays so the sets that are
+ * being probed stay in the host's L1/L2: one contiguous tag array, a
+ * packed valid bitmap, and a 32 bit policy word per way. Row i owns
+ * tags[i*E .. i*E+E-1], the policy words of the same range, and vwords
+ * 64 bit words of valid bits at valid[i*vwords], with dirty bits laid
+ * out the same way. A dense cache gives set i row i; a sparse one hands
+ * out rows in the order sets are first touched and finds them through a
+ * hash table, so memory follows the sets in use, not 2^s. The policy
+ * word is the clock at last use (LRU) or fill (FIFO), the re-reference
+ * prediction (RRIP) or a pseudo-LRU tree node (PLRU).
+ */
+typedef struct cache {
+    int s, E, b;                  /* geometry: 2^s sets, E ways, 2^b blocks */
+    int vwords;                   /* valid bitmap words per set */
+    int policy;
+    int sparse;                   /* rows are allocated as sets are touched */
+    size_t nrows, maxrows;        /* rows in use and allocated */
+    unsigned long long *set_key;  /* sparse: set index of each table entry */
+    size_t *set_row;              /* sparse: row of each entry, or ~0 */
+    size_t set_mask;              /* sparse: table entries - 1 */
+    unsigned long long *tags;
+    unsigned long long *valid;
+    unsigned long long *dirty;
+    int written;                  /* a dirty bit has been set */
+    unsigned int *stamp;          /* policy word, 0 = never used */
+    unsigned int clock;
+    unsigned long long rng;       /* xorshift state for RANDOM and BRRIP */
+    unsigned long long *next;     /* OPT: next reference to each way */
+    const unsigned long long *future;   /* OPT: next reference per access */
+    unsigned long long refs;      /* accesses made so far */
+    /* set probes chosen for the host CPU (see cache.c) */
+    unsigned long long (*match)(const unsigned long long *tags, int n,
+                                unsigned long long tag);
+    int (*argmin)(const unsigned int *stamp, int n);
+    unsigned long long victim;    /* block evicted by the last CACHE_EVICT */
+    int victim_dirty;
+    unsigned long hits, misses, evictions, writebacks;
+} cache_t;
+
+/* Largest set index bit count; s + b may use all 64 address bits */
+#define CACHE_MAX_S 62
+
+/* Caches of more lines than this keep their sets sparse (see cache_new) */
+#define CACHE_DENSE_LINES (1UL << 24)
+
+/* cache_set - Index of the set addr maps to, for 2^s sets of 2^b bytes */
+static inline size_t cache_set(int s, int b, unsigned long long addr)
+{
+    return (size_t)((addr >> b) & ((1ULL << s) - 1));
+}
+
+/* cache_tag - Tag of addr: the address bits above the set index */
+static inline unsigned long long cache_tag(int s, int b, unsigned long long addr)
+{
+    return s + b < 64 ? addr >> (s + b) : 0;
+}
+
+/*
+ * Set probes come in AVX2, SSE4.1 and scalar versions; cache_new uses
+ * the best one the CPU supports, or the one named by the CSIM_SIMD
+ * environment variable ("avx2", "sse4" or "scalar").
+ */
+const char *cache_simd_name(void);
+
+/* Policy number for a name such as "lru" or "opt", or -1 */
+int cache_policy(const char *name);
+
+/* Name of a policy number */
+const char *cache_policy_name(int policy);
+
+/*
+ * cache_new - Allocate an empty cache. It is sparse if it has more than
+ *     CACHE_DENSE_LINES lines, else dense. Returns NULL if out of memory
+ *     or the policy cannot handle the geometry.
+ */
+cache_t *cache_new(int s, int E, int b, int policy);
+
+/* cache_new_sparse - cache_new for a cache that is always sparse */
+cache_t *cache_new_sparse(int s, int E, int b, int policy);
+
+/* Release a cache returned by cache_new */
+void cache_free(cache_t *c);
+
+/*
+ * cache_flush - Empty the cache as at a cold start. The counters and
+ *     the access count OPT indexes its future by carry on.
+ */
+void cache_flush(cache_t *c);
+
+/*
+ * cache_set_future - Give an OPT cache the index of the next access to
+ *     the same block for every access it will see, or CACHE_NEVER. The
+ *     array must outlive the simulation.
+ */
+void cache_set_future(cache_t *c, const unsigned long long *future);
+
+/*
+ * cache_lookup - Look up addr, filling the block on a miss and evicting
+ *     the victim chosen by the policy from a full set. Updates the
+ *     counters and returns CACHE_HIT, CACHE_MISS or CACHE_EVICT; after
+ *     CACHE_EVICT the victim's block address and dirty bit are in
+ *     c->victim and c->victim_dirty. flags is a mask of CACHE_WRITE,
+ *     CACHE_NOALLOC and CACHE_FILL; a CACHE_FILL of a present block
+ *     only applies CACHE_WRITE.
+ */
+int cache_lookup(cache_t *c, unsigned long long addr, int flags);
+
+/*
+ * cache_access - Read addr; the same as cache_lookup with no flags, but
+ *     it leaves c->victim alone
+ */
+int cache_access(cache_t *c, unsigned long long addr);
+
+/*
+ * cache_invalidate - Drop the block holding addr. Returns -1 if it was
+ *     not cached, else 1 if the line was dirty and 0 if it was clean.
+ */
+int cache_invalidate(cache_t *c, unsigned long long addr);
+
+/*
+ * cache_ref - Apply one trace record the way csim counts it: I records
+ *     are ignored and M is a load followed by a store that always hits
+ */
+static inline void cache_ref(cache_t *c, const trace_rec_t *rec)
+{
+    if (rec->op == 'I')
+        return;
+    cache_access(c, rec->addr);
+    if (rec->op == 'M')
+        c->hits++;
+}
+
+#endif /* CACHELAB_CACHE_H */
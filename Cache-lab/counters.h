@@ -0,0 +1,35 @@
+/*
+ * counters.h - Hardware cache miss counters through perf_event_open
+ */
+
+#ifndef CACHELAB_COUNTERS_H
+#define CACHELAB_COUNTERS_H
+
+/* The events counted, in the order counters_stop reports them */
+#define COUNTER_L1D_MISS 0   /* L1 data cache read misses */
+#define COUNTER_LLC_MISS 1   /* last level cache misses */
+#define NUM_COUNTERS     2
+
+/*
+ * counters_open - Open the counters for the calling thread. Returns how
+ *     many could be opened: none on kernels or machines without a PMU,
+ *     or where perf_event_paranoid forbids it.
+ */
+int counters_open(void);
+
+/* Zero the open counters and start them */
+void counters_start(void);
+
+/*
+ * counters_stop - Stop the counters and store their counts in v, with
+ *     -1 for any that could not be opened
+ */
+void counters_stop(long long v[NUM_COUNTERS]);
+
+/* Close the counters */
+void counters_close(void);
+
+/* Short name of counter i, for column headings */
+const char *counter_name(int i);
+
+#endif /* CACHELAB_COUNTERS_H */
@@ -2,27 +2,581 @@
  Name : Maosen Zhang
  ID : 1500012898
 */
+#define _GNU_SOURCE
 #include"cachelab.h"
+#include"trace.h"
+#include"cache.h"
+#include"hier.h"
+#include"attrib.h"
+#include"shadow.h"
+#include"prefetch.h"
 #include<getopt.h>
 #include<stdlib.h>
 #include<unistd.h>
 #include<string.h>
-#include<math.h>
-#include<malloc.h>
 #include<stdio.h>
+#include<errno.h>
+#include<pthread.h>
+#include<sched.h>
+
+/* records decoded per chunk of the shared sweep stream */
+#define SWEEP_CHUNK 65536
+#define MAX_SWEEP 256
+/* addresses per shard ring, and how many the reader queues before publishing */
+#define SHARD_RING 65536
+#define SHARD_BATCH 256
+#define MAX_SHARDS 64
+/* instructions listed by --addr2line when --pcs is not given */
+#define DEFAULT_PCS 20
+
+/*
+ * The sweep mode decodes the trace once into two chunk buffers. While
+ * the workers run their caches over one chunk the main thread decodes
+ * the next into the other; a barrier separates the two phases.
+ */
+typedef struct {
+	trace_rec_t *buf[2];
+	int n[2];
+	pthread_barrier_t barrier;
+} sweep_stream;
+
+typedef struct {
+	sweep_stream *stream;
+	cache_t **caches;
+	int ncaches;
+} sweep_worker;
+
+/*
+ * The parallel mode shards the sets: with 2^k workers, worker i owns
+ * the sets whose top k index bits equal i and simulates them as a cache
+ * of 2^(s-k) sets. The main thread decodes the trace and hands each
+ * data address to its owner through a single-producer single-consumer
+ * ring; head and tail sit on their own cache lines.
+ */
 typedef struct {
-	long long tag;
-	int v,recent;
-}line;
+	unsigned long long *buf;
+	unsigned long head;              /* written by the reader */
+	char pad0[64-sizeof(unsigned long)];
+	unsigned long tail;              /* written by the worker */
+	char pad1[64-sizeof(unsigned long)];
+	int done;
+	cache_t *cache;
+} shard_ring;
+
+/* set by --sparse: give every cache sparse set storage */
+static int sparse_sets;
+
+static struct option long_options[] = {
+	{"sweep", required_argument, NULL, 'w'},
+	{"threads", required_argument, NULL, 'j'},
+	{"pcs", required_argument, NULL, 'P'},
+	{"addr2line", required_argument, NULL, 'a'},
+	{"3c", no_argument, NULL, 'C'},
+	{"sparse", no_argument, NULL, 'S'},
+	{"prefetch", required_argument, NULL, 'f'},
+	{"L2", required_argument, NULL, '2'},
+	{"LLC", required_argument, NULL, '3'},
+	{"inclusion", required_argument, NULL, 'i'},
+	{"write-through", no_argument, NULL, 'T'},
+	{"no-write-allocate", no_argument, NULL, 'A'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0}
+};
+
+static void usage(char **argv){
+	printf("Usage: %s [-h] -s <s> -E <E> -b <b> [-p <policy>] [-j <n>] [-m <markerfile>] -t <tracefile>\n", argv[0]);
+	printf("       %s --sweep <s:E:b[:policy]>[,...] -t <tracefile>\n", argv[0]);
+	printf("       %s -s <s> -E <E> -b <b> [--L2 <s:E:b[:policy]>] [--LLC <s:E:b[:policy]>]\n"
+	       "            [--inclusion <mode>] [--write-through] [--no-write-allocate] -t <tracefile>\n", argv[0]);
+	printf("Options:\n");
+	printf("  -h                Print this help message.\n");
+	printf("  -s <s>            Number of set index bits.\n");
+	printf("  -E <E>            Number of lines per set.\n");
+	printf("  -b <b>            Number of block offset bits.\n");
+	printf("  -p <policy>       Replacement policy: lru (default), fifo, random,\n");
+	printf("                    plru, srrip, brrip or opt.\n");
+	printf("  -t <tracefile>    Trace to replay (text or binary), - for stdin.\n");
+	printf("  -m <markerfile>   Only simulate the tracegen marker region.\n");
+	printf("  --pcs <n>         Report the n instructions with most misses (0 = all).\n");
+	printf("  --addr2line <bin> Name the source line of each reported instruction.\n");
+	printf("  --sparse          Allocate sets as they are touched (automatic for\n");
+	printf("                    caches of more than %lu lines).\n", CACHE_DENSE_LINES);
+	printf("  --prefetch <list> Run prefetchers next, stride and/or stream, each as\n");
+	printf("                    name[:degree], and report their accuracy, coverage\n");
+	printf("                    and pollution. Evictions include those by prefetches.\n");
+	printf("  --3c              Split misses into compulsory, capacity and conflict,\n");
+	printf("                    per marker region with -m.\n");
+	printf("  -j <n>            Split the sets over up to n threads.\n");
+	printf("  --sweep <list>    Simulate every s:E:b[:policy] in the list in one pass.\n");
+	printf("  --L2, --LLC <geo> Add a lower cache level below the -s/-E/-b L1.\n");
+	printf("  --inclusion <m>   nine (default), inclusive or exclusive.\n");
+	printf("  --write-through   Send every write down instead of writing back.\n");
+	printf("  --no-write-allocate  Do not fill the block on a write miss.\n");
+	printf("Examples: %s --sweep 5:1:5,4:2:5,4:2:5:opt -t traces/trans.trace\n", argv[0]);
+	printf("          %s -s 4 -E 1 -b 4 --L2 6:4:4 --inclusion inclusive -t traces/yi.trace\n", argv[0]);
+	printf("          %s -s 5 -E 1 -b 5 --pcs 10 --addr2line tracegen -t trace.full\n", argv[0]);
+	printf("          %s -s 5 -E 1 -b 5 --prefetch next,stride:4 -t trace.full\n", argv[0]);
+	printf("          ./tracegen -M 32 -N 32 -F 0 -t - | %s -s 5 -E 1 -b 5 -m .marker -t -\n", argv[0]);
+}
+
+/*
+ * open_trace - open the trace, restricted to the marker region if marker
+ * is set (or to every marker region if all is set)
+ */
+static trace_t *open_trace(const char *tracefile, const char *marker, int all){
+	trace_t *trace=trace_open(tracefile);
+	if(trace==NULL){
+		fprintf(stderr, "%s: %s\n", tracefile, strerror(errno));
+		exit(1);
+	}
+	if(marker)
+		trace_set_markers(trace,marker,all);
+	return trace;
+}
+
+/* Slot of blk in an open addressing table of mask+1 entries */
+static inline unsigned long hash_slot(unsigned long long blk, unsigned long mask){
+	return (unsigned long)((blk*0x9E3779B97F4A7C15ULL)>>32) & mask;
+}
+
+/*
+ * build_future - for the i-th data access of the trace, store the index
+ * of the next access to the same 2^b byte block (CACHE_NEVER if none).
+ * This is what OPT needs; the trace is decoded once and then walked
+ * backwards with a table of the last seen index of each block.
+ */
+static unsigned long long *build_future(const char *tracefile, const char *marker,
+	int all, int b){
+	unsigned long long *blk, *future, *keys, i, n=0, cap=1<<16;
+	unsigned long mask=(1<<16)-1, h;
+	trace_t *trace;
+	trace_rec_t rec;
+
+	trace=open_trace(tracefile,marker,all);
+	blk=malloc(sizeof(unsigned long long)*cap);
+	while(blk && trace_next(trace,&rec)){
+		if(rec.op=='I')
+			continue;
+		if(n==cap)
+			blk=realloc(blk,sizeof(unsigned long long)*(cap*=2));
+		if(blk)
+			blk[n++]=rec.addr>>b;
+	}
+	trace_close(trace);
+
+	/* A table of at least twice the accesses can never fill up */
+	while(mask+1<2*n)
+		mask=2*mask+1;
+	future=malloc(sizeof(unsigned long long)*(n?n:1));
+	keys=malloc(sizeof(unsigned long long)*(mask+1)*2);
+	if(!blk || !future || !keys){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	/* keys[2h] is a block, keys[2h+1] its latest index (CACHE_NEVER = empty) */
+	for(h=0;h<=mask;++h)
+		keys[2*h+1]=CACHE_NEVER;
+	for(i=n;i-->0;){
+		for(h=hash_slot(blk[i],mask); keys[2*h+1]!=CACHE_NEVER && keys[2*h]!=blk[i];)
+			h=(h+1)&mask;
+		future[i]=keys[2*h+1];
+		keys[2*h]=blk[i];
+		keys[2*h+1]=i;
+	}
+	free(keys);
+	free(blk);
+	return future;
+}
+
+/* read_trace_chunk - decode up to SWEEP_CHUNK records into buf */
+static int read_trace_chunk(trace_t *trace, trace_rec_t *buf){
+	int n=0;
+	while(n<SWEEP_CHUNK && trace_next(trace,&buf[n]))
+		n++;
+	return n;
+}
+
+/* sweep_thread - replay every chunk of the stream through one group of caches */
+static void *sweep_thread(void *arg){
+	sweep_worker *w=arg;
+	sweep_stream *st=w->stream;
+	int cur=0,i,k;
+	for(;;){
+		pthread_barrier_wait(&st->barrier);
+		if(st->n[cur]==0)
+			break;
+		for(i=0;i<st->n[cur];++i)
+			for(k=0;k<w->ncaches;++k)
+				cache_ref(w->caches[k],&st->buf[cur][i]);
+		pthread_barrier_wait(&st->barrier);
+		cur^=1;
+	}
+	return NULL;
+}
+
+/*
+ * run_sweep - simulate all caches from a single pass over the trace,
+ * with the caches split round-robin over one worker per CPU
+ */
+static void run_sweep(trace_t *trace, cache_t **caches, int ncaches){
+	sweep_stream st;
+	sweep_worker *workers;
+	pthread_t *tids;
+	int nworkers,i,cur=0;
+	long ncpu=sysconf(_SC_NPROCESSORS_ONLN);
+
+	nworkers = ncpu<1 ? 1 : (ncpu<ncaches ? ncpu : ncaches);
+	workers=calloc(nworkers,sizeof(sweep_worker));
+	tids=calloc(nworkers,sizeof(pthread_t));
+	st.buf[0]=malloc(sizeof(trace_rec_t)*SWEEP_CHUNK);
+	st.buf[1]=malloc(sizeof(trace_rec_t)*SWEEP_CHUNK);
+	if(!workers || !tids || !st.buf[0] || !st.buf[1]){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	for(i=0;i<nworkers;++i){
+		workers[i].stream=&st;
+		workers[i].caches=malloc(sizeof(cache_t*)*ncaches);
+	}
+	for(i=0;i<ncaches;++i){
+		sweep_worker *w=&workers[i%nworkers];
+		w->caches[w->ncaches++]=caches[i];
+	}
+	pthread_barrier_init(&st.barrier,NULL,nworkers+1);
+	for(i=0;i<nworkers;++i)
+		pthread_create(&tids[i],NULL,sweep_thread,&workers[i]);
+
+	st.n[cur]=read_trace_chunk(trace,st.buf[cur]);
+	for(;;){
+		pthread_barrier_wait(&st.barrier);
+		if(st.n[cur]==0)
+			break;
+		st.n[cur^1]=read_trace_chunk(trace,st.buf[cur^1]);
+		pthread_barrier_wait(&st.barrier);
+		cur^=1;
+	}
+
+	for(i=0;i<nworkers;++i){
+		pthread_join(tids[i],NULL);
+		free(workers[i].caches);
+	}
+	pthread_barrier_destroy(&st.barrier);
+	free(st.buf[0]);
+	free(st.buf[1]);
+	free(workers);
+	free(tids);
+}
+
+/* new_cache - cache_new that exits with a message on failure */
+static cache_t *new_cache(int s, int E, int b, int policy){
+	cache_t *c=sparse_sets ? cache_new_sparse(s,E,b,policy) : cache_new(s,E,b,policy);
+	if(c==NULL){
+		if(policy==POLICY_PLRU && (E&(E-1)))
+			fprintf(stderr, "Error: plru needs E to be a power of two\n");
+		else
+			fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	return c;
+}
+
+/*
+ * parse_geometry - parse one "s:E:b[:policy]" at *list into a cache and
+ * advance *list past it. A tuple without a policy uses policy.
+ */
+static cache_t *parse_geometry(char **list, int policy){
+	int s,E,b,len,plen;
+	char name[16];
+	if(sscanf(*list,"%d:%d:%d%n",&s,&E,&b,&len)!=3 || s<0 || E<1 || b<0 || b>63 || s>CACHE_MAX_S || s+b>64){
+		fprintf(stderr, "Error: bad cache configuration at \"%s\"\n", *list);
+		exit(1);
+	}
+	if((*list)[len]==':'){
+		if(sscanf(*list+len+1,"%15[a-z]%n",name,&plen)!=1
+			|| (policy=cache_policy(name))<0){
+			fprintf(stderr, "Error: bad policy at \"%s\"\n", *list);
+			exit(1);
+		}
+		len+=plen+1;
+	}
+	*list+=len;
+	return new_cache(s,E,b,policy);
+}
+
+/* parse_sweep - parse "s:E:b[:policy],..." into caches, returning how many */
+static int parse_sweep(char *list, int policy, cache_t **caches){
+	int n=0;
+	while(*list){
+		if(n==MAX_SWEEP){
+			fprintf(stderr, "Error: more than %d sweep configurations\n", MAX_SWEEP);
+			exit(1);
+		}
+		caches[n++]=parse_geometry(&list,policy);
+		if(*list==',') list++;
+	}
+	return n;
+}
+
+/*
+ * attach_futures - build one next-use index per block size used by an
+ * OPT cache, returning how many were stored in futures
+ */
+static int attach_futures(const char *tracefile, const char *marker, int all,
+	cache_t **caches, int ncaches, unsigned long long **futures){
+	int i,j,nfutures=0;
+	for(i=0;i<ncaches;++i){
+		if(caches[i]->policy!=POLICY_OPT)
+			continue;
+		for(j=0;j<i;++j)
+			if(caches[j]->policy==POLICY_OPT && caches[j]->b==caches[i]->b)
+				break;
+		if(j<i)
+			cache_set_future(caches[i],caches[j]->future);
+		else
+			cache_set_future(caches[i],futures[nfutures++]=build_future(tracefile,marker,all,caches[i]->b));
+	}
+	return nfutures;
+}
+
+/* shard_thread - simulate the addresses arriving on one ring */
+static void *shard_thread(void *arg){
+	shard_ring *r=arg;
+	unsigned long head,tail=0;
+	for(;;){
+		head=__atomic_load_n(&r->head,__ATOMIC_ACQUIRE);
+		if(head==tail){
+			if(__atomic_load_n(&r->done,__ATOMIC_ACQUIRE)
+				&& __atomic_load_n(&r->head,__ATOMIC_ACQUIRE)==tail)
+				break;
+			sched_yield();
+			continue;
+		}
+		while(tail!=head)
+			cache_access(r->cache,r->buf[tail++ & (SHARD_RING-1)]);
+		__atomic_store_n(&r->tail,tail,__ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/*
+ * run_sharded - simulate one cache with its sets split over up to
+ * nthreads workers (rounded down to a power of two no larger than the
+ * set count) and merge the counters into total
+ */
+static void run_sharded(trace_t *trace, int s, int E, int b, int policy,
+	int nthreads, cache_t *total){
+	shard_ring *rings;
+	pthread_t tids[MAX_SHARDS];
+	unsigned long pend[MAX_SHARDS], done[MAX_SHARDS];
+	int k=0,n,i,sl;
+	trace_rec_t rec;
+	shard_ring *r;
+
+	while(k<s && (2<<k)<=nthreads && (2<<k)<=MAX_SHARDS)
+		k++;
+	n=1<<k;
+	sl=s-k;
+	if((rings=calloc(n,sizeof(shard_ring)))==NULL){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	for(i=0;i<n;++i){
+		rings[i].buf=malloc(sizeof(unsigned long long)*SHARD_RING);
+		if(rings[i].buf==NULL){
+			fprintf(stderr, "Error: out of memory\n");
+			exit(1);
+		}
+		rings[i].cache=new_cache(sl,E,b,policy);
+		pend[i]=done[i]=0;
+		pthread_create(&tids[i],NULL,shard_thread,&rings[i]);
+	}
+
+	while(trace_next(trace,&rec)){
+		if(rec.op=='I')
+			continue;
+		if(rec.op=='M')
+			total->hits++;
+		r=&rings[cache_set(s,b,rec.addr)>>sl];
+		i=r-rings;
+		/* Wait for room, publishing what is queued so the worker can drain it */
+		while(pend[i]-done[i]==SHARD_RING){
+			__atomic_store_n(&r->head,pend[i],__ATOMIC_RELEASE);
+			if((done[i]=__atomic_load_n(&r->tail,__ATOMIC_ACQUIRE))+SHARD_RING==pend[i])
+				sched_yield();
+		}
+		r->buf[pend[i]++ & (SHARD_RING-1)]=rec.addr;
+		if(pend[i]%SHARD_BATCH==0)
+			__atomic_store_n(&r->head,pend[i],__ATOMIC_RELEASE);
+	}
+
+	for(i=0;i<n;++i){
+		__atomic_store_n(&rings[i].head,pend[i],__ATOMIC_RELEASE);
+		__atomic_store_n(&rings[i].done,1,__ATOMIC_RELEASE);
+	}
+	for(i=0;i<n;++i){
+		pthread_join(tids[i],NULL);
+		total->hits+=rings[i].cache->hits;
+		total->misses+=rings[i].cache->misses;
+		total->evictions+=rings[i].cache->evictions;
+		cache_free(rings[i].cache);
+		free(rings[i].buf);
+	}
+	free(rings);
+}
+
+/*
+ * run_attributed - simulate the trace, charging every data access to the
+ * instruction record before it, and print the top instructions after
+ * the summary
+ */
+static void run_attributed(trace_t *trace, cache_t *c, int top, const char *binary){
+	attrib_t *a=attrib_new();
+	unsigned long long pc=0;
+	trace_rec_t rec;
+	int r=0;
+	while(a && r==0 && trace_next(trace,&rec)){
+		if(rec.op=='I'){
+			pc=rec.addr;
+			continue;
+		}
+		r=attrib_count(a,pc,cache_access(c,rec.addr));
+		if(rec.op=='M'){
+			c->hits++;
+			r|=attrib_count(a,pc,CACHE_HIT);
+		}
+	}
+	if(!a || r){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	printSummary(c->hits, c->misses, c->evictions);
+	attrib_print(a,top,binary,binary ? attrib_load_base(binary) : 0);
+	attrib_free(a);
+}
+
+/* print_3c_row - one line of the 3C table; cls is indexed by SHADOW_* */
+static void print_3c_row(const char *label, const unsigned long *count,
+	const unsigned long *cls){
+	printf("%6s %12lu %12lu %12lu %12lu %12lu %12lu\n",label,count[0],count[1],
+		count[2],cls[SHADOW_COLD],cls[SHADOW_MISS],cls[SHADOW_HIT]);
+}
+
+/*
+ * run_3c - simulate the trace next to a fully associative LRU cache of
+ * the same capacity. A miss is compulsory if the block was never seen,
+ * a capacity miss if the shadow misses too, and a conflict miss if the
+ * shadow hits. With regions set, each marker region starts from cold
+ * caches and gets its own row.
+ */
+static void run_3c(trace_t *trace, cache_t *c, int regions){
+	shadow_t *sh=shadow_new((unsigned long)c->E<<c->s);
+	unsigned long cls[3]={0,0,0}, total[3]={0,0,0}, base[3]={0,0,0}, count[3];
+	int region=-1, r, k, nrows=0;
+	trace_rec_t rec;
+	char label[16];
+
+	if(sh==NULL){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	printf("%6s %12s %12s %12s %12s %12s %12s\n","region","hits","misses",
+		"evictions","compulsory","capacity","conflict");
+	for(;;){
+		r=trace_next(trace,&rec);
+		if(r && rec.op=='I')
+			continue;
+		/* Close the row of a finished region */
+		if(regions && region>=0 && (!r || trace_region(trace)!=region)){
+			count[0]=c->hits-base[0];
+			count[1]=c->misses-base[1];
+			count[2]=c->evictions-base[2];
+			sprintf(label,"%d",region);
+			print_3c_row(label,count,cls);
+			for(k=0;k<3;++k){
+				total[k]+=cls[k];
+				cls[k]=0;
+			}
+			base[0]=c->hits;
+			base[1]=c->misses;
+			base[2]=c->evictions;
+			nrows++;
+			cache_flush(c);
+			shadow_free(sh);
+			if((sh=shadow_new((unsigned long)c->E<<c->s))==NULL){
+				fprintf(stderr, "Error: out of memory\n");
+				exit(1);
+			}
+		}
+		if(!r)
+			break;
+		region=regions ? trace_region(trace) : 0;
+		r=cache_access(c,rec.addr);
+		if((k=shadow_access(sh,rec.addr>>c->b))<0){
+			fprintf(stderr, "Error: out of memory\n");
+			exit(1);
+		}
+		if(r!=CACHE_HIT)
+			cls[k]++;
+		if(rec.op=='M')
+			c->hits++;
+	}
+	if(!regions || nrows>1){
+		count[0]=c->hits;
+		count[1]=c->misses;
+		count[2]=c->evictions;
+		print_3c_row(regions ? "total" : "trace",count,regions ? total : cls);
+	}
+	shadow_free(sh);
+}
+
+/*
+ * run_prefetch - simulate the trace with the prefetchers named in list,
+ * a comma separated list of name[:degree]
+ */
+static void run_prefetch(trace_t *trace, cache_t *c, char *list){
+	prefetch_t *p=prefetch_new(c);
+	trace_rec_t rec;
+	char *name, *colon;
+	int kind, degree;
+	if(p==NULL){
+		fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	for(name=strtok(list,",");name;name=strtok(NULL,",")){
+		degree=0;
+		if((colon=strchr(name,':'))!=NULL){
+			*colon='\0';
+			degree=atoi(colon+1);
+		}
+		if((kind=prefetch_kind(name))<0 || (colon && degree<1) || prefetch_add(p,kind,degree)<0){
+			fprintf(stderr, "Error: bad prefetcher \"%s\"\n", name);
+			exit(1);
+		}
+	}
+	while(trace_next(trace,&rec)){
+		if(prefetch_ref(p,&rec)<0){
+			fprintf(stderr, "Error: out of memory\n");
+			exit(1);
+		}
+	}
+	printSummary(c->hits, c->misses, c->evictions);
+	prefetch_print(p);
+	prefetch_free(p);
+}
+
 int main(int argc, char** argv){
-	char c;
-	line** sets;
-	int s, S, E, b, oc, hit_count=0, miss_count=0, eviction_count=0; 
-	int tmp,i,exist,full,evict,count_opers=0,least_recent,target,empty_one;
-	unsigned set_index;
-	unsigned long long addr,tag;
-	char *tracefile;
-	while((oc=getopt(argc, argv, "s:E:b:t:"))!=-1){
+	int s=-1, E=0, b=-1, oc, i, ncaches=0, nfutures, policy=POLICY_LRU;
+	int levels=0, inclusion=HIER_NINE, write_back=1, write_alloc=1, nthreads=1, pcs=-1;
+	int three_c=0;
+	char *tracefile=NULL, *sweep=NULL, *marker=NULL, *lower[2]={NULL,NULL}, *binary=NULL;
+	char *prefetchers=NULL;
+	const char *names[HIER_MAX_LEVELS]={"L1","L2","LLC"};
+	hier_t hier;
+	cache_t *caches[MAX_SWEEP];
+	unsigned long long *futures[MAX_SWEEP];
+	trace_t *trace;
+	trace_rec_t rec;
+	while((oc=getopt_long(argc, argv, "s:E:b:p:j:m:t:h", long_options, NULL))!=-1){
 		switch(oc){
 			case's':
 				s = atoi(optarg);
@@ -33,66 +587,156 @@ int main(int argc, char** argv){
 			case'b':
 				b = atoi(optarg);
 				break;
+			case'p':
+				if((policy=cache_policy(optarg))<0){
+					fprintf(stderr, "Error: unknown policy \"%s\"\n", optarg);
+					exit(1);
+				}
+				break;
 			case't':
 				tracefile=optarg;
 				break;
+			case'm':
+				marker=optarg;
+				break;
+			case'w':
+				sweep=optarg;
+				break;
+			case'j':
+				nthreads=atoi(optarg);
+				break;
+			case'P':
+				pcs=atoi(optarg);
+				break;
+			case'a':
+				binary=optarg;
+				break;
+			case'C':
+				three_c=1;
+				break;
+			case'S':
+				sparse_sets=1;
+				break;
+			case'f':
+				prefetchers=optarg;
+				break;
+			case'2':
+			case'3':
+				lower[oc-'2']=optarg;
+				levels=1;
+				break;
+			case'i':
+				if((inclusion=hier_inclusion(optarg))<0){
+					fprintf(stderr, "Error: unknown inclusion policy \"%s\"\n", optarg);
+					exit(1);
+				}
+				levels=1;
+				break;
+			case'T':
+				write_back=0;
+				levels=1;
+				break;
+			case'A':
+				write_alloc=0;
+				levels=1;
+				break;
+			case'h':
+				usage(argv);
+				exit(0);
+			default:
+				usage(argv);
+				exit(1);
 		}
 	}
-	S = pow(2,s);
-	sets = (line**)malloc(sizeof(line*)*S);
-	for (i = 0; i < S; ++i) {
-		sets[i] = (line*)malloc(sizeof(line)*E);
-		memset(sets[i], 0, sizeof(line)*E);
-	}
-	freopen(tracefile,"r",stdin);
-	while(scanf("%c",&c)!=EOF){
-		if(c=='I' || c=='L' || c=='M' || c=='S'){
-			scanf("%llx,%d",&addr,&tmp);
-			set_index = ((unsigned int)addr<<(32-s-b))>>(32-s);
-			tag = addr>>(s+b);
-			if(c!='I'){
-				exist=empty_one=0;
-				full=1;
-				least_recent = count_opers+1;
-				for(i=0;i<E;++i){
-					if(sets[set_index][i].recent<least_recent){
-						evict=i;
-						least_recent=sets[set_index][i].recent;
-					}
-					if(sets[set_index][i].v && sets[set_index][i].tag==tag){
-						exist=1;
-						target = i;
-					}
-					if(!sets[set_index][i].v){
-						full=0;
-						if(!empty_one) empty_one=i;
-					}
-				}
-				if(exist){
-					hit_count++;
-				}
-				else if(!full){
-					miss_count++;
-					target=empty_one;
-					sets[set_index][target].v = 1;
-					sets[set_index][target].tag=tag;
-				}
-				else {
-					miss_count++;
-					eviction_count++;
-					target=evict;
-					sets[set_index][evict].tag=tag;
-				}
-				if(c=='M') hit_count++;
-				sets[set_index][target].recent=count_opers;
-				count_opers++;
-			}
+	if(tracefile==NULL || (!sweep && (s<0 || E<1 || b<0 || b>63 || s>CACHE_MAX_S || s+b>64))
+		|| (sweep && levels)
+		|| nthreads<1 || (nthreads>1 && (sweep || levels))
+		|| ((pcs>=0 || binary || three_c || prefetchers) && (sweep || levels || nthreads>1))
+		|| (three_c && (pcs>=0 || binary)) || (prefetchers && (three_c || pcs>=0 || binary))){
+		usage(argv);
+		exit(1);
+	}
+	if(sweep)
+		ncaches=parse_sweep(sweep,policy,caches);
+	else{
+		caches[0]=new_cache(s,E,b,policy);
+		ncaches=1;
+		for(i=0;i<2;++i){
+			if(!lower[i])
+				continue;
+			names[ncaches]=names[i+1];
+			caches[ncaches++]=parse_geometry(&lower[i],policy);
 		}
 	}
-	printSummary(hit_count, miss_count, eviction_count);
-	for (i = 0;i < S; ++i){
-		free(sets[i]);
+	/* OPT numbers the accesses of the whole trace, not of one shard */
+	if(nthreads>1 && policy==POLICY_OPT){
+		fprintf(stderr, "Error: -j does not support the opt policy\n");
+		exit(1);
+	}
+	/* The levels pass whole blocks between them, and OPT cannot see the
+	   access stream of a level ahead of time */
+	for(i=0;levels && i<ncaches;++i){
+		if(caches[i]->b!=b || caches[i]->policy==POLICY_OPT){
+			fprintf(stderr, "Error: hierarchy levels need the same -b and a policy other than opt\n");
+			exit(1);
+		}
+	}
+	/* OPT reads the trace twice, which a stream cannot offer */
+	for(i=0;i<ncaches;++i){
+		if(caches[i]->policy==POLICY_OPT && strcmp(tracefile,"-")==0){
+			fprintf(stderr, "Error: the opt policy cannot read the trace from stdin\n");
+			exit(1);
+		}
+	}
+	nfutures=attach_futures(tracefile,marker,three_c,caches,ncaches,futures);
+	trace=open_trace(tracefile,marker,three_c);
+	if(sweep){
+		run_sweep(trace,caches,ncaches);
+		printf("%4s %6s %4s %7s %12s %12s %12s\n","s","E","b","policy","hits","misses","evictions");
+		for(i=0;i<ncaches;++i)
+			printf("%4d %6d %4d %7s %12lu %12lu %12lu\n",caches[i]->s,caches[i]->E,
+				caches[i]->b,cache_policy_name(caches[i]->policy),
+				caches[i]->hits,caches[i]->misses,caches[i]->evictions);
+	}
+	else if(levels){
+		hier_init(&hier,caches,ncaches,inclusion,write_back,write_alloc);
+		while(trace_next(trace,&rec))
+			hier_ref(&hier,&rec);
+		printSummary(caches[0]->hits, caches[0]->misses, caches[0]->evictions);
+		printf("%-5s %4s %6s %4s %12s %12s %12s %12s\n","level","s","E","b",
+			"hits","misses","evictions","writebacks");
+		for(i=0;i<ncaches;++i)
+			printf("%-5s %4d %6d %4d %12lu %12lu %12lu %12lu\n",names[i],caches[i]->s,
+				caches[i]->E,caches[i]->b,caches[i]->hits,caches[i]->misses,
+				caches[i]->evictions,caches[i]->writebacks);
+		printf("memory reads:%lu writes:%lu", hier.mem_reads, hier.mem_writes);
+		if(inclusion==HIER_INCLUSIVE)
+			printf(" back-invalidations:%lu", hier.back_invalidations);
+		printf("\n");
+	}
+	else if(three_c){
+		run_3c(trace,caches[0],marker!=NULL);
+		printSummary(caches[0]->hits, caches[0]->misses, caches[0]->evictions);
+	}
+	else if(prefetchers){
+		run_prefetch(trace,caches[0],prefetchers);
+	}
+	else if(pcs>=0 || binary){
+		run_attributed(trace,caches[0],pcs<0 ? DEFAULT_PCS : pcs,binary);
+	}
+	else if(nthreads>1){
+		run_sharded(trace,s,E,b,policy,nthreads,caches[0]);
+		printSummary(caches[0]->hits, caches[0]->misses, caches[0]->evictions);
+	}
+	else{
+		while(trace_next(trace,&rec))
+			cache_ref(caches[0],&rec);
+		printSummary(caches[0]->hits, caches[0]->misses, caches[0]->evictions);
 	}
-	free(sets);
+	trace_close(trace);
+	for(i=0;i<ncaches;++i)
+		cache_free(caches[i]);
+	for(i=0;i<nfutures;++i)
+		free(futures[i]);
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,171 @@
+/*
+ * hier.c - Multi-level cache hierarchy
+ *
+ * A demand access that misses in level i fills the block there and
+ * fetches it from level i+1. The block it displaces is handled by the
+ * inclusion policy:
+ *
+ *   NINE       a dirty victim is written back into the next level,
+ *              which neither tracks nor evicts the levels above it.
+ *   inclusive  as NINE, and a victim of level i is also invalidated in
+ *              every level above it (back-invalidation); a dirty copy
+ *              found there is folded into the writeback. The block of
+ *              the access under way is spared: the levels above have
+ *              just filled it, and the fetch still to come puts it
+ *              back below.
+ *   exclusive  the lower levels are victim caches: a fetch that hits
+ *              there moves the block up, and every victim, clean or
+ *              dirty, is placed in the next level.
+ *
+ * Under write-through every write is also sent to the next level (or
+ * memory) and lines never become dirty.
+ */
+#include <string.h>
+#include "hier.h"
+
+static const char *inclusion_names[] = { "nine", "inclusive", "exclusive" };
+
+/*
+ * hier_inclusion - Look up an inclusion policy by name
+ */
+int hier_inclusion(const char *name)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (strcmp(name, inclusion_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+/*
+ * hier_init - Set up a hierarchy over the given caches
+ */
+void hier_init(hier_t *h, cache_t **levels, int nlevels, int inclusion,
+               int write_back, int write_alloc)
+{
+    int i;
+
+    memset(h, 0, sizeof(*h));
+    h->nlevels = nlevels;
+    for (i = 0; i < nlevels; i++)
+        h->level[i] = levels[i];
+    h->inclusion = inclusion;
+    h->write_back = write_back;
+    h->write_alloc = write_alloc;
+}
+
+static void put_victim(hier_t *h, int i, unsigned long long victim, int dirty);
+
+/*
+ * place - Put a block into level i (or memory) without counting it as a
+ *     demand access, marking it dirty if dirty is set
+ */
+static void place(hier_t *h, int i, unsigned long long addr, int dirty)
+{
+    cache_t *c;
+
+    if (i == h->nlevels) {
+        if (dirty)
+            h->mem_writes++;
+        return;
+    }
+    c = h->level[i];
+    if (cache_lookup(c, addr, CACHE_FILL | (dirty ? CACHE_WRITE : 0)) == CACHE_EVICT)
+        put_victim(h, i, c->victim, c->victim_dirty);
+}
+
+/*
+ * put_victim - Handle a block evicted from level i
+ */
+static void put_victim(hier_t *h, int i, unsigned long long victim, int dirty)
+{
+    int j, d;
+
+    if (h->inclusion == HIER_INCLUSIVE) {
+        for (j = 0; j < i; j++) {
+            if ((victim ^ h->demand) >> h->level[j]->b == 0)
+                continue;
+            if ((d = cache_invalidate(h->level[j], victim)) < 0)
+                continue;
+            h->back_invalidations++;
+            if (d) {
+                h->level[j]->writebacks++;
+                dirty = 1;
+            }
+        }
+    }
+    if (dirty || h->inclusion == HIER_EXCLUSIVE)
+        place(h, i + 1, victim, dirty);
+}
+
+/*
+ * access_level - Demand read or write of addr at level i (or memory).
+ *     Returns 1 when an exclusive level hands up a dirty block.
+ */
+static int access_level(hier_t *h, int i, unsigned long long addr, int write)
+{
+    int below = h->inclusion == HIER_EXCLUSIVE && i > 0;
+    int flags = 0, r, dirty = 0, vdirty = 0;
+    unsigned long long victim = 0;
+    cache_t *c;
+
+    if (i == h->nlevels) {
+        if (write)
+            h->mem_writes++;
+        else
+            h->mem_reads++;
+        return 0;
+    }
+    c = h->level[i];
+    if (write && h->write_back)
+        flags |= CACHE_WRITE;
+    if (below || (write && !h->write_alloc))
+        flags |= CACHE_NOALLOC;
+
+    r = cache_lookup(c, addr, flags);
+    if (r == CACHE_EVICT) {
+        victim = c->victim;
+        vdirty = c->victim_dirty;
+        /* Write back before fetching; exclusive swaps after the fetch */
+        if (h->inclusion != HIER_EXCLUSIVE)
+            put_victim(h, i, victim, vdirty);
+    }
+    if (r == CACHE_HIT) {
+        if (below && !write)
+            dirty = cache_invalidate(c, addr) > 0;
+    }
+    else if (!(flags & CACHE_NOALLOC)) {
+        if (access_level(h, i + 1, addr, 0))
+            cache_lookup(c, addr, CACHE_FILL | CACHE_WRITE);
+    }
+    else if (below && !write)
+        dirty = access_level(h, i + 1, addr, 0);
+    else if (h->write_back)
+        access_level(h, i + 1, addr, 1);   /* write around this level */
+    if (write && !h->write_back)
+        access_level(h, i + 1, addr, 1);
+    if (r == CACHE_EVICT && h->inclusion == HIER_EXCLUSIVE)
+        put_victim(h, i, victim, vdirty);
+    return dirty;
+}
+
+/*
+ * hier_ref - Apply one trace record, M being a load then a store
+ */
+void hier_ref(hier_t *h, const trace_rec_t *rec)
+{
+    h->demand = rec->addr;
+    switch (rec->op) {
+    case 'L':
+        access_level(h, 0, rec->addr, 0);
+        break;
+    case 'S':
+        access_level(h, 0, rec->addr, 1);
+        break;
+    case 'M':
+        access_level(h, 0, rec->addr, 0);
+        access_level(h, 0, rec->addr, 1);
+        break;
+    }
+}
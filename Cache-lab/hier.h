@@ -0,0 +1,50 @@
+/*
+ * hier.h - Prototypes for the multi-level cache hierarchy built from
+ *     the cache model in cache.h
+ */
+
+#ifndef CACHELAB_HIER_H
+#define CACHELAB_HIER_H
+
+#include "trace.h"
+#include "cache.h"
+
+#define HIER_MAX_LEVELS 3
+
+/* How the contents of a level relate to the levels above it */
+#define HIER_NINE      0   /* non-inclusive non-exclusive */
+#define HIER_INCLUSIVE 1   /* evicting a block invalidates it above */
+#define HIER_EXCLUSIVE 2   /* a block lives in at most one level */
+
+/*
+ * Level 0 is the L1 that sees the trace; a miss is fetched from the
+ * next level down and the last level fetches from memory. The write
+ * policy and write allocation apply to every level. Each level keeps
+ * its own counters in its cache_t; hits and misses count demand
+ * accesses only, writebacks count dirty lines sent down.
+ */
+typedef struct hier {
+    int nlevels;
+    cache_t *level[HIER_MAX_LEVELS];
+    int inclusion;
+    int write_back;               /* else write-through */
+    int write_alloc;              /* fill the block on a write miss */
+    unsigned long long demand;    /* address of the record being applied */
+    unsigned long back_invalidations;   /* inclusive: lines dropped above */
+    unsigned long mem_reads, mem_writes;
+} hier_t;
+
+/* Inclusion policy number for "nine", "inclusive" or "exclusive", or -1 */
+int hier_inclusion(const char *name);
+
+/*
+ * hier_init - Set up a hierarchy over nlevels caches, ordered from L1
+ *     down. The caches remain owned by the caller.
+ */
+void hier_init(hier_t *h, cache_t **levels, int nlevels, int inclusion,
+               int write_back, int write_alloc);
+
+/* hier_ref - Apply one trace record; I records are ignored */
+void hier_ref(hier_t *h, const trace_rec_t *rec);
+
+#endif /* CACHELAB_HIER_H */
@@ -0,0 +1,107 @@
+/*
+ * memtrace.c - The access hooks for code built with MEMTRACE_CFLAGS
+ *
+ * gcc's thread sanitizer instrumentation calls __tsan_readN or
+ * __tsan_writeN with the address before every access to memory, and
+ * __tsan_init from a constructor. With the function entry and exit
+ * hooks turned off that is all it needs from a runtime, so the objects
+ * are linked without libtsan and the hooks here record the accesses
+ * instead of checking them for races. This file must not be built with
+ * the instrumentation itself.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "memtrace.h"
+
+/* Output buffer; a 256x256 transpose writes a few MB of trace */
+#define TRACE_BUF (1 << 20)
+
+static FILE *trace_fp;
+static int recording;
+
+static inline void record(char op, unsigned long addr, unsigned long size)
+{
+    if (recording)
+        fprintf(trace_fp, " %c %08lx,%lu\n", op, addr, size);
+}
+
+#define HOOKS(n)                                                      \
+    void __tsan_read##n(unsigned long addr);                          \
+    void __tsan_write##n(unsigned long addr);                         \
+    void __tsan_unaligned_read##n(unsigned long addr);                \
+    void __tsan_unaligned_write##n(unsigned long addr);               \
+    void __tsan_read##n(unsigned long addr)                           \
+    {                                                                 \
+        record('L', addr, n);                                         \
+    }                                                                 \
+    void __tsan_write##n(unsigned long addr)                          \
+    {                                                                 \
+        record('S', addr, n);                                         \
+    }                                                                 \
+    void __tsan_unaligned_read##n(unsigned long addr)                 \
+    {                                                                 \
+        record('L', addr, n);                                         \
+    }                                                                 \
+    void __tsan_unaligned_write##n(unsigned long addr)                \
+    {                                                                 \
+        record('S', addr, n);                                         \
+    }
+
+HOOKS(1)
+HOOKS(2)
+HOOKS(4)
+HOOKS(8)
+HOOKS(16)
+
+/* Accesses of other sizes, such as whole structs */
+void __tsan_read_range(unsigned long addr, unsigned long size);
+void __tsan_write_range(unsigned long addr, unsigned long size);
+
+void __tsan_read_range(unsigned long addr, unsigned long size)
+{
+    record('L', addr, size);
+}
+
+void __tsan_write_range(unsigned long addr, unsigned long size)
+{
+    record('S', addr, size);
+}
+
+/* Called by a constructor in every instrumented object; nothing to do */
+void __tsan_init(void);
+
+void __tsan_init(void)
+{
+}
+
+int memtrace_open(const char *path)
+{
+    if (strcmp(path, "-") == 0)
+        trace_fp = stdout;
+    else if ((trace_fp = fopen(path, "w")) == NULL)
+        return -1;
+    setvbuf(trace_fp, NULL, _IOFBF, TRACE_BUF);
+    return 0;
+}
+
+void memtrace_on(void)
+{
+    recording = 1;
+}
+
+void memtrace_off(void)
+{
+    recording = 0;
+}
+
+int memtrace_close(void)
+{
+    int err = ferror(trace_fp);
+
+    if (trace_fp == stdout)
+        err |= fflush(trace_fp);
+    else
+        err |= fclose(trace_fp);
+    trace_fp = NULL;
+    return err ? -1 : 0;
+}
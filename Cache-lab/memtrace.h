@@ -0,0 +1,30 @@
+/*
+ * memtrace.h - Record the data accesses of instrumented code as a
+ *     lackey style trace, without running under valgrind
+ *
+ * Code compiled with MEMTRACE_CFLAGS (see the Makefile) calls a hook
+ * before each load and store it makes through memory, volatile ones
+ * included, and memtrace.c supplies the hooks. Between memtrace_on and
+ * memtrace_off every such access is written to the trace as
+ * " L addr,size" or " S addr,size". Locals the compiler keeps in
+ * registers make no accesses, and the ones left on the stack lie above
+ * 0xffffffff, so csim's marker filter drops them as it drops valgrind's.
+ */
+
+#ifndef CACHELAB_MEMTRACE_H
+#define CACHELAB_MEMTRACE_H
+
+/*
+ * memtrace_open - Start a trace in the file at path, or on standard
+ *     output for "-". Returns -1 if the file cannot be created.
+ */
+int memtrace_open(const char *path);
+
+/* Start and stop recording the accesses of instrumented code */
+void memtrace_on(void);
+void memtrace_off(void);
+
+/* Flush and close the trace; returns -1 if writing it failed */
+int memtrace_close(void);
+
+#endif /* CACHELAB_MEMTRACE_H */
@@ -0,0 +1,376 @@
+/*
+ * prefetch.c - Hardware prefetcher models
+ *
+ * After each demand access the enabled prefetchers predict blocks and
+ * fill them into the cache with CACHE_FILL, which places a block without
+ * counting an access. Two tables keep the books. One maps every block
+ * filled by a prefetch and not yet touched to the prefetcher that filled
+ * it: a demand hit on such a block makes the prefetch useful, and its
+ * eviction makes it useless. The other maps every block a prefetch fill
+ * evicted to the prefetcher responsible, so a later demand miss on it
+ * counts as pollution. Prefetches are timely by construction, as the
+ * simulator has no notion of latency.
+ *
+ * The prefetchers are
+ *   next    - tagged next-line: a miss, or the first hit on a prefetched
+ *             block, fills the following degree blocks.
+ *   stride  - a reference prediction table indexed by the pc of the
+ *             access (the last I record). Once an instruction repeats a
+ *             stride it fills degree strides ahead; strides shorter than
+ *             a block look ahead whole blocks instead.
+ *   stream  - stream buffers. A miss next to a recent miss starts an
+ *             ascending or descending stream, and each miss or first hit
+ *             inside a stream's window keeps it degree blocks ahead.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+
+/* Entries of the stride table (a power of two) and stream buffers */
+#define STRIDE_ENTRIES 256
+#define STREAMS 8
+
+/* Block map entries with src < 0 are empty */
+typedef struct {
+    unsigned long long block;
+    int src;
+} entry_t;
+
+typedef struct {
+    entry_t *slot;
+    unsigned long mask, used;
+} blockmap_t;
+
+typedef struct {
+    unsigned long long pc, last;
+    long long stride;           /* last difference of addresses */
+} stride_t;
+
+typedef struct {
+    unsigned long long last;    /* block of the last access it matched */
+    int dir;                    /* +1 or -1, 0 while training */
+    unsigned int used;          /* stamp for LRU replacement, 0 = free */
+} stream_t;
+
+typedef struct {
+    unsigned long issued, useful, polluting;
+} pf_stat;
+
+struct prefetch {
+    cache_t *c;
+    int degree[NUM_PREFETCHERS];        /* 0 = not enabled */
+    unsigned long long pc;
+    blockmap_t pending;                 /* filled, not yet used */
+    blockmap_t evicted;                 /* evicted by a fill */
+    stride_t stride[STRIDE_ENTRIES];
+    stream_t stream[STREAMS];
+    unsigned int clock;
+    pf_stat stat[NUM_PREFETCHERS];
+};
+
+static const char *names[NUM_PREFETCHERS] = {"next", "stride", "stream"};
+static const int default_degree[NUM_PREFETCHERS] = {1, 2, 4};
+
+int prefetch_kind(const char *name)
+{
+    int k;
+
+    for (k = 0; k < NUM_PREFETCHERS; k++)
+        if (strcmp(name, names[k]) == 0)
+            return k;
+    return -1;
+}
+
+const char *prefetch_name(int kind)
+{
+    return names[kind];
+}
+
+static inline unsigned long block_slot(unsigned long long block,
+                                       unsigned long mask)
+{
+    return (unsigned long)((block * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+static entry_t *new_slots(unsigned long size)
+{
+    entry_t *t = malloc(sizeof(entry_t) * size);
+    unsigned long i;
+
+    if (t != NULL)
+        for (i = 0; i < size; i++)
+            t[i].src = -1;
+    return t;
+}
+
+/* map_find - Slot holding block, or the empty slot where it would go */
+static inline unsigned long map_find(const blockmap_t *m,
+                                     unsigned long long block)
+{
+    unsigned long h;
+
+    for (h = block_slot(block, m->mask); m->slot[h].src >= 0 &&
+         m->slot[h].block != block; h = (h + 1) & m->mask)
+        ;
+    return h;
+}
+
+/*
+ * map_put - Map block to src, doubling the table when it gets half
+ *     full. Returns -1 if out of memory.
+ */
+static int map_put(blockmap_t *m, unsigned long long block, int src)
+{
+    unsigned long h = map_find(m, block), i, mask;
+    entry_t *t;
+
+    if (m->slot[h].src < 0) {
+        if (2 * (m->used + 1) > m->mask) {
+            mask = 2 * m->mask + 1;
+            if ((t = new_slots(mask + 1)) == NULL)
+                return -1;
+            for (i = 0; i <= m->mask; i++) {
+                if (m->slot[i].src < 0)
+                    continue;
+                for (h = block_slot(m->slot[i].block, mask); t[h].src >= 0;)
+                    h = (h + 1) & mask;
+                t[h] = m->slot[i];
+            }
+            free(m->slot);
+            m->slot = t;
+            m->mask = mask;
+            h = map_find(m, block);
+        }
+        m->used++;
+        m->slot[h].block = block;
+    }
+    m->slot[h].src = src;
+    return 0;
+}
+
+/*
+ * map_del - Remove block and return what it mapped to, or -1 if it was
+ *     absent. Later entries of the probe run shift back into the hole,
+ *     so lookups never need tombstones.
+ */
+static int map_del(blockmap_t *m, unsigned long long block)
+{
+    unsigned long i = map_find(m, block), j, k;
+    int src = m->slot[i].src;
+
+    if (src < 0)
+        return -1;
+    for (j = i;;) {
+        j = (j + 1) & m->mask;
+        if (m->slot[j].src < 0)
+            break;
+        k = block_slot(m->slot[j].block, m->mask);
+        /* Move the entry unless its home lies cyclically in (i, j] */
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+            m->slot[i] = m->slot[j];
+            i = j;
+        }
+    }
+    m->slot[i].src = -1;
+    m->used--;
+    return src;
+}
+
+prefetch_t *prefetch_new(cache_t *c)
+{
+    prefetch_t *p = calloc(1, sizeof(prefetch_t));
+
+    if (p == NULL)
+        return NULL;
+    p->c = c;
+    p->pending.mask = p->evicted.mask = 1023;
+    p->pending.slot = new_slots(p->pending.mask + 1);
+    p->evicted.slot = new_slots(p->evicted.mask + 1);
+    if (p->pending.slot == NULL || p->evicted.slot == NULL) {
+        prefetch_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void prefetch_free(prefetch_t *p)
+{
+    free(p->pending.slot);
+    free(p->evicted.slot);
+    free(p);
+}
+
+int prefetch_add(prefetch_t *p, int kind, int degree)
+{
+    if (kind < 0 || kind >= NUM_PREFETCHERS || p->degree[kind] || degree < 0)
+        return -1;
+    p->degree[kind] = degree ? degree : default_degree[kind];
+    return 0;
+}
+
+/*
+ * issue - Fill the block holding addr for prefetcher src, unless it is
+ *     already cached. Returns -1 if out of memory.
+ */
+static int issue(prefetch_t *p, int src, unsigned long long addr)
+{
+    cache_t *c = p->c;
+    unsigned long long victim;
+    int r = cache_lookup(c, addr, CACHE_FILL);
+
+    if (r == CACHE_HIT)
+        return 0;
+    p->stat[src].issued++;
+    if (r == CACHE_EVICT) {
+        /* Pushing out an unused prefetch is not pollution */
+        victim = c->victim >> c->b;
+        if (map_del(&p->pending, victim) < 0 &&
+            map_put(&p->evicted, victim, src) < 0)
+            return -1;
+    }
+    map_del(&p->evicted, addr >> c->b);
+    return map_put(&p->pending, addr >> c->b, src);
+}
+
+/* next_line - Fill the degree blocks after blk */
+static int next_line(prefetch_t *p, unsigned long long blk)
+{
+    int k;
+
+    for (k = 1; k <= p->degree[PF_NEXT]; k++)
+        if (issue(p, PF_NEXT, (blk + k) << p->c->b) < 0)
+            return -1;
+    return 0;
+}
+
+/*
+ * stride - Train the table entry of the current pc on addr and fill
+ *     ahead of a stride seen at least twice in a row
+ */
+static int stride(prefetch_t *p, unsigned long long addr)
+{
+    stride_t *e = &p->stride[block_slot(p->pc, STRIDE_ENTRIES - 1)];
+    long long d = (long long)(addr - e->last), step;
+    long long bsize = 1LL << p->c->b;
+    int k;
+
+    if (e->pc != p->pc) {
+        e->pc = p->pc;
+        e->last = addr;
+        e->stride = 0;
+        return 0;
+    }
+    e->last = addr;
+    if (d != e->stride || d == 0) {
+        e->stride = d;
+        return 0;
+    }
+    step = d > -bsize && d < bsize ? (d < 0 ? -bsize : bsize) : d;
+    for (k = 1; k <= p->degree[PF_STRIDE]; k++)
+        if (issue(p, PF_STRIDE, addr + (unsigned long long)(step * k)) < 0)
+            return -1;
+    return 0;
+}
+
+/*
+ * stream - Advance the stream whose window holds blk, confirm a training
+ *     stream next to it, or replace the least recently used stream
+ */
+static int stream(prefetch_t *p, unsigned long long blk)
+{
+    stream_t *st, *lru = &p->stream[0];
+    long long ahead;
+    int i, k;
+
+    for (i = 0; i < STREAMS; i++) {
+        st = &p->stream[i];
+        if (st->used < lru->used)
+            lru = st;
+        if (!st->used)
+            continue;
+        ahead = (long long)(blk - st->last);
+        if (st->dir == 0 && (ahead == 1 || ahead == -1))
+            st->dir = (int)ahead;
+        else if (st->dir == 0 || ahead * st->dir <= 0 ||
+                 ahead * st->dir > p->degree[PF_STREAM])
+            continue;
+        st->last = blk;
+        st->used = ++p->clock;
+        for (k = 1; k <= p->degree[PF_STREAM]; k++)
+            if (issue(p, PF_STREAM, (blk + (long long)st->dir * k) << p->c->b) < 0)
+                return -1;
+        return 0;
+    }
+    lru->last = blk;
+    lru->dir = 0;
+    lru->used = ++p->clock;
+    return 0;
+}
+
+int prefetch_ref(prefetch_t *p, const trace_rec_t *rec)
+{
+    cache_t *c = p->c;
+    unsigned long long blk = rec->addr >> c->b;
+    int r, src, trigger;
+
+    if (rec->op == 'I') {
+        p->pc = rec->addr;
+        return 0;
+    }
+    r = cache_lookup(c, rec->addr, 0);
+    if (rec->op == 'M')
+        c->hits++;
+    if (r == CACHE_EVICT)
+        map_del(&p->pending, c->victim >> c->b);
+    if (r == CACHE_HIT) {
+        if ((trigger = (src = map_del(&p->pending, blk)) >= 0))
+            p->stat[src].useful++;
+    }
+    else {
+        trigger = 1;
+        if ((src = map_del(&p->evicted, blk)) >= 0)
+            p->stat[src].polluting++;
+    }
+
+    if (p->degree[PF_STRIDE] && stride(p, rec->addr) < 0)
+        return -1;
+    if (!trigger)
+        return 0;
+    if (p->degree[PF_NEXT] && next_line(p, blk) < 0)
+        return -1;
+    if (p->degree[PF_STREAM] && stream(p, blk) < 0)
+        return -1;
+    return 0;
+}
+
+static void print_row(const char *name, const pf_stat *st,
+                      unsigned long useful, unsigned long misses)
+{
+    printf("%8s %12lu %12lu %9.4f %9.4f %12lu\n", name, st->issued,
+           st->useful, st->issued ? (double)st->useful / st->issued : 0.0,
+           useful + misses ? (double)st->useful / (useful + misses) : 0.0,
+           st->polluting);
+}
+
+void prefetch_print(const prefetch_t *p)
+{
+    pf_stat total = {0, 0, 0};
+    int k, n = 0;
+
+    for (k = 0; k < NUM_PREFETCHERS; k++) {
+        total.issued += p->stat[k].issued;
+        total.useful += p->stat[k].useful;
+        total.polluting += p->stat[k].polluting;
+    }
+    printf("%8s %12s %12s %9s %9s %12s\n", "prefetch", "issued", "useful",
+           "accuracy", "coverage", "pollution");
+    for (k = 0; k < NUM_PREFETCHERS; k++) {
+        if (!p->degree[k])
+            continue;
+        print_row(names[k], &p->stat[k], total.useful, p->c->misses);
+        n++;
+    }
+    if (n > 1)
+        print_row("total", &total, total.useful, p->c->misses);
+}
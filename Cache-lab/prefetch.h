@@ -0,0 +1,58 @@
+/*
+ * prefetch.h - Prototypes for the hardware prefetcher models that can
+ *     run in front of a cache
+ */
+
+#ifndef CACHELAB_PREFETCH_H
+#define CACHELAB_PREFETCH_H
+
+#include "trace.h"
+#include "cache.h"
+
+/* Prefetcher kinds */
+#define PF_NEXT       0   /* tagged next-line */
+#define PF_STRIDE     1   /* stride table indexed by the pc of the access */
+#define PF_STREAM     2   /* sequential stream buffers */
+#define NUM_PREFETCHERS 3
+
+/* A cache with prefetchers; the layout is private to prefetch.c */
+typedef struct prefetch prefetch_t;
+
+/* Prefetcher kind for a name such as "next" or "stride", or -1 */
+int prefetch_kind(const char *name);
+
+/* Name of a prefetcher kind */
+const char *prefetch_name(int kind);
+
+/*
+ * prefetch_new - Put prefetchers in front of c, which must be empty.
+ *     Returns NULL if out of memory.
+ */
+prefetch_t *prefetch_new(cache_t *c);
+
+/* Release p (but not its cache) */
+void prefetch_free(prefetch_t *p);
+
+/*
+ * prefetch_add - Enable a prefetcher of the given kind. degree is how
+ *     many blocks or strides it runs ahead, or 0 for the kind's default.
+ *     Each kind can be added once; returns -1 if it was added already.
+ */
+int prefetch_add(prefetch_t *p, int kind, int degree);
+
+/*
+ * prefetch_ref - Apply one trace record the way cache_ref does, then let
+ *     the prefetchers fill the blocks they predict. I records only set
+ *     the pc seen by the stride table. Returns -1 if out of memory.
+ */
+int prefetch_ref(prefetch_t *p, const trace_rec_t *rec);
+
+/*
+ * prefetch_print - Print the blocks each prefetcher filled, the
+ *     fraction that were used before eviction (accuracy), the fraction of
+ *     would-be misses they removed (coverage), and the demand misses to
+ *     blocks their fills evicted (pollution)
+ */
+void prefetch_print(const prefetch_t *p);
+
+#endif /* CACHELAB_PREFETCH_H */
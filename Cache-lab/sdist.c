@@ -0,0 +1,281 @@
+/*
+ * sdist.c - Single pass LRU miss curves from stack (reuse) distances
+ *
+ * Under LRU a reference hits in an E-way set exactly when fewer than E
+ * distinct blocks of the same set were touched since the previous
+ * reference to its block (Mattson et al., 1970). sdist computes that
+ * per-set stack distance for every reference once, and from the
+ * histogram reads off the hits, misses and evictions csim would report
+ * for every associativity up to a limit, for each set count in a range.
+ *
+ * Distances are counted with a Fenwick tree over each set's local
+ * timestamps in which only the latest reference to every block is
+ * marked, so the distance of a reference is a prefix-sum difference
+ * and the whole trace costs O(N log N) per set count.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "trace.h"
+
+#define DEFAULT_MAXE 16
+
+/* The data references of a trace, reduced to dense block ids */
+typedef struct {
+    unsigned int *ref;              /* block id of each reference */
+    unsigned long nref;
+    unsigned long long *block;      /* block number of each id */
+    unsigned int nblock;
+    unsigned long mhits;            /* store halves of M records */
+} refs_t;
+
+static void *xmalloc(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void *xcalloc(size_t n, size_t size)
+{
+    void *p = calloc(n ? n : 1, size);
+
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* Slot of blk in an open addressing table of mask+1 entries */
+static inline unsigned int hash_slot(unsigned long long blk, unsigned int mask)
+{
+    return (unsigned int)((blk * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+/*
+ * load_refs - Decode the trace once, numbering each distinct block in
+ *     the order it is first touched
+ */
+static void load_refs(trace_t *trace, int b, refs_t *r)
+{
+    unsigned long long blk, *keys, *okeys;
+    unsigned int *vals, *ovals, mask = 1023, omask, h, i, id;
+    unsigned long cap = 1 << 16, bcap = 1 << 16;
+    trace_rec_t rec;
+
+    memset(r, 0, sizeof(*r));
+    r->ref = xmalloc(sizeof(unsigned int) * cap);
+    r->block = xmalloc(sizeof(unsigned long long) * bcap);
+    keys = xmalloc(sizeof(unsigned long long) * (mask + 1));
+    vals = xmalloc(sizeof(unsigned int) * (mask + 1));
+    memset(vals, 0xff, sizeof(unsigned int) * (mask + 1));
+
+    while (trace_next(trace, &rec)) {
+        if (rec.op == 'I')
+            continue;
+        if (rec.op == 'M')
+            r->mhits++;
+        blk = rec.addr >> b;
+        for (h = hash_slot(blk, mask); vals[h] != ~0u && keys[h] != blk;)
+            h = (h + 1) & mask;
+        if ((id = vals[h]) == ~0u) {
+            if (r->nblock == bcap) {
+                bcap *= 2;
+                r->block = realloc(r->block, sizeof(unsigned long long) * bcap);
+                if (r->block == NULL) {
+                    fprintf(stderr, "Error: out of memory\n");
+                    exit(1);
+                }
+            }
+            id = r->nblock++;
+            r->block[id] = blk;
+            keys[h] = blk;
+            vals[h] = id;
+            /* Keep the table at most half full */
+            if (2 * r->nblock > mask) {
+                okeys = keys;
+                ovals = vals;
+                omask = mask;
+                mask = 2 * mask + 1;
+                keys = xmalloc(sizeof(unsigned long long) * (mask + 1));
+                vals = xmalloc(sizeof(unsigned int) * (mask + 1));
+                memset(vals, 0xff, sizeof(unsigned int) * (mask + 1));
+                for (i = 0; i <= omask; i++) {
+                    if (ovals[i] == ~0u)
+                        continue;
+                    for (h = hash_slot(okeys[i], mask); vals[h] != ~0u;)
+                        h = (h + 1) & mask;
+                    keys[h] = okeys[i];
+                    vals[h] = ovals[i];
+                }
+                free(okeys);
+                free(ovals);
+            }
+        }
+        if (r->nref == cap) {
+            cap *= 2;
+            r->ref = realloc(r->ref, sizeof(unsigned int) * cap);
+            if (r->ref == NULL) {
+                fprintf(stderr, "Error: out of memory\n");
+                exit(1);
+            }
+        }
+        r->ref[r->nref++] = id;
+    }
+    free(keys);
+    free(vals);
+}
+
+/*
+ * curve - Compute the stack distance histogram for 2^s sets and print
+ *     hits, misses and evictions for E = 1..maxE
+ */
+static void curve(const refs_t *r, int s, int maxE)
+{
+    unsigned long S = 1UL << s, set, i, j, p, dist;
+    unsigned long *cnt = xcalloc(S, sizeof(unsigned long));
+    unsigned long *base = xmalloc(sizeof(unsigned long) * S);
+    unsigned long *now = xcalloc(S, sizeof(unsigned long));
+    unsigned long *cold = xcalloc(S, sizeof(unsigned long));
+    unsigned long *hist = xcalloc(maxE + 1, sizeof(unsigned long));
+    unsigned long *fill = xcalloc(maxE + 2, sizeof(unsigned long));
+    unsigned long *last = xcalloc(r->nblock, sizeof(unsigned long));
+    unsigned int *tree = xcalloc(r->nref, sizeof(unsigned int));
+    unsigned long ncold = 0, hits = 0, misses, n, sum;
+    unsigned long filled = 0, atleast = S;
+    unsigned int *t;
+    int E;
+
+    /* Give every set a Fenwick tree sized to its own reference count */
+    for (i = 0; i < r->nref; i++)
+        cnt[r->block[r->ref[i]] & (S - 1)]++;
+    for (set = 0, sum = 0; set < S; set++) {
+        base[set] = sum;
+        sum += cnt[set];
+    }
+
+    for (i = 0; i < r->nref; i++) {
+        set = r->block[r->ref[i]] & (S - 1);
+        t = tree + base[set] - 1;   /* one based within the set */
+        n = cnt[set];
+        now[set]++;
+        p = last[r->ref[i]];
+        if (p == 0) {
+            ncold++;
+            cold[set]++;
+        }
+        else {
+            /* Distinct blocks since p = marks in (p, now) */
+            dist = 0;
+            for (j = now[set] - 1; j > 0; j -= j & -j)
+                dist += t[j];
+            for (j = p; j > 0; j -= j & -j)
+                dist -= t[j];
+            hist[dist < (unsigned long)maxE ? dist : (unsigned long)maxE]++;
+            for (j = p; j <= n; j += j & -j)
+                t[j]--;
+        }
+        for (j = now[set]; j <= n; j += j & -j)
+            t[j]++;
+        last[r->ref[i]] = now[set];
+    }
+
+    /* Fills into empty ways: sum over sets of min(E, distinct blocks) */
+    for (set = 0; set < S; set++)
+        fill[cold[set] < (unsigned long)maxE ? cold[set] : (unsigned long)maxE]++;
+
+    printf("s=%d (%lu sets), %lu references, %lu compulsory misses\n",
+           s, S, r->nref, ncold);
+    printf("%6s %12s %12s %12s %10s\n",
+           "E", "hits", "misses", "evictions", "miss-ratio");
+    for (E = 1; E <= maxE; E++) {
+        /* Sets holding at least E distinct blocks fill E empty ways */
+        atleast -= fill[E - 1];
+        filled += atleast;
+        hits += hist[E - 1];
+        misses = r->nref - hits;
+        printf("%6d %12lu %12lu %12lu %10.4f\n", E, hits + r->mhits,
+               misses, misses - filled,
+               r->nref ? (double)misses / (r->nref + r->mhits) : 0.0);
+    }
+    printf("\n");
+
+    free(cnt); free(base); free(now); free(cold);
+    free(hist); free(fill); free(last); free(tree);
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] -s <lo>[:<hi>] -b <b> [-E <maxE>] -t <tracefile>\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h              Print this help message.\n");
+    printf("  -s <lo>[:<hi>]  Range of set index bits to report.\n");
+    printf("  -b <b>          Number of block offset bits.\n");
+    printf("  -E <maxE>       Largest associativity to report (default %d).\n",
+           DEFAULT_MAXE);
+    printf("  -t <file>       Trace to analyze (text or binary).\n");
+    printf("Example: %s -s 0:5 -b 5 -E 8 -t traces/trans.trace\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, slo = -1, shi = -1, b = -1, maxE = DEFAULT_MAXE, s;
+    char *tracefile = NULL;
+    trace_t *trace;
+    refs_t refs;
+
+    while ((c = getopt(argc, argv, "s:b:E:t:h")) != -1) {
+        switch (c) {
+        case 's':
+            if (sscanf(optarg, "%d:%d", &slo, &shi) == 1)
+                shi = slo;
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'E':
+            maxE = atoi(optarg);
+            break;
+        case 't':
+            tracefile = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (tracefile == NULL || slo < 0 || shi < slo || b < 0 || b > 63 ||
+        maxE < 1 || shi + b > 64 || shi > 30) {
+        usage(argv);
+        exit(1);
+    }
+
+    if ((trace = trace_open(tracefile)) == NULL) {
+        fprintf(stderr, "%s: %s\n", tracefile, strerror(errno));
+        exit(1);
+    }
+    load_refs(trace, b, &refs);
+    trace_close(trace);
+
+    for (s = slo; s <= shi; s++)
+        curve(&refs, s, maxE);
+
+    free(refs.ref);
+    free(refs.block);
+    return 0;
+}
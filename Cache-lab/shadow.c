@@ -0,0 +1,170 @@
+/*
+ * shadow.c - Fully associative LRU cache of a fixed number of lines
+ *
+ * Every block ever referenced has an entry in an open addressing table,
+ * which both answers whether a miss is compulsory and points at the
+ * block's line if it is resident. The resident lines form a doubly
+ * linked list in recency order, so a hit is one table probe and a list
+ * splice, and the victim is always the tail.
+ */
+#include <stdlib.h>
+#include "shadow.h"
+
+/* Entry.line values for an empty slot and a block that is not cached */
+#define SLOT_EMPTY -2
+#define NOT_CACHED -1
+
+typedef struct {
+    unsigned long long block;
+    long line;                  /* resident line, or one of the above */
+} entry_t;
+
+typedef struct {
+    long prev, next;            /* neighbours in recency order, -1 at ends */
+    unsigned long slot;         /* table slot of the block held */
+} line_t;
+
+struct shadow {
+    entry_t *table;
+    unsigned long mask, used;
+    line_t *line;
+    unsigned long lines, nresident;
+    long head, tail;            /* most and least recently used lines */
+};
+
+static inline unsigned long block_slot(unsigned long long block,
+                                       unsigned long mask)
+{
+    return (unsigned long)((block * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+static entry_t *new_table(unsigned long size)
+{
+    entry_t *t = malloc(sizeof(entry_t) * size);
+    unsigned long i;
+
+    if (t != NULL)
+        for (i = 0; i < size; i++)
+            t[i].line = SLOT_EMPTY;
+    return t;
+}
+
+shadow_t *shadow_new(unsigned long lines)
+{
+    shadow_t *sh = calloc(1, sizeof(shadow_t));
+
+    if (sh == NULL)
+        return NULL;
+    sh->lines = lines ? lines : 1;
+    sh->mask = 1023;
+    sh->head = sh->tail = -1;
+    sh->table = new_table(sh->mask + 1);
+    sh->line = malloc(sizeof(line_t) * sh->lines);
+    if (sh->table == NULL || sh->line == NULL) {
+        shadow_free(sh);
+        return NULL;
+    }
+    return sh;
+}
+
+void shadow_free(shadow_t *sh)
+{
+    free(sh->table);
+    free(sh->line);
+    free(sh);
+}
+
+/*
+ * grow - Double the table, moving every entry and fixing the slot
+ *     numbers held by the resident lines
+ */
+static int grow(shadow_t *sh)
+{
+    unsigned long mask = 2 * sh->mask + 1, i, h;
+    entry_t *t = new_table(mask + 1);
+
+    if (t == NULL)
+        return -1;
+    for (i = 0; i <= sh->mask; i++) {
+        if (sh->table[i].line == SLOT_EMPTY)
+            continue;
+        for (h = block_slot(sh->table[i].block, mask); t[h].line != SLOT_EMPTY;)
+            h = (h + 1) & mask;
+        t[h] = sh->table[i];
+        if (t[h].line >= 0)
+            sh->line[t[h].line].slot = h;
+    }
+    free(sh->table);
+    sh->table = t;
+    sh->mask = mask;
+    return 0;
+}
+
+static void unlink_line(shadow_t *sh, long l)
+{
+    line_t *ln = &sh->line[l];
+
+    if (ln->prev >= 0)
+        sh->line[ln->prev].next = ln->next;
+    else
+        sh->head = ln->next;
+    if (ln->next >= 0)
+        sh->line[ln->next].prev = ln->prev;
+    else
+        sh->tail = ln->prev;
+}
+
+static void push_front(shadow_t *sh, long l)
+{
+    sh->line[l].prev = -1;
+    sh->line[l].next = sh->head;
+    if (sh->head >= 0)
+        sh->line[sh->head].prev = l;
+    else
+        sh->tail = l;
+    sh->head = l;
+}
+
+int shadow_access(shadow_t *sh, unsigned long long block)
+{
+    unsigned long h;
+    int result;
+    long l;
+
+    for (h = block_slot(block, sh->mask); sh->table[h].line != SLOT_EMPTY &&
+         sh->table[h].block != block; h = (h + 1) & sh->mask)
+        ;
+    if (sh->table[h].line == SLOT_EMPTY) {
+        /* Keep the table at most half full */
+        if (2 * (sh->used + 1) > sh->mask) {
+            if (grow(sh) < 0)
+                return -1;
+            return shadow_access(sh, block);
+        }
+        sh->used++;
+        sh->table[h].block = block;
+        sh->table[h].line = NOT_CACHED;
+        result = SHADOW_COLD;
+    }
+    else if ((l = sh->table[h].line) >= 0) {
+        if (l != sh->head) {
+            unlink_line(sh, l);
+            push_front(sh, l);
+        }
+        return SHADOW_HIT;
+    }
+    else
+        result = SHADOW_MISS;
+
+    if (sh->nresident < sh->lines)
+        l = sh->nresident++;
+    else {
+        l = sh->tail;
+        unlink_line(sh, l);
+        sh->table[sh->line[l].slot].line = NOT_CACHED;
+    }
+    sh->line[l].slot = h;
+    sh->table[h].line = l;
+    push_front(sh, l);
+    return result;
+}
@@ -0,0 +1,29 @@
+/*
+ * shadow.h - Prototypes for the fully associative LRU shadow cache used
+ *     to split misses into compulsory, capacity and conflict misses
+ */
+
+#ifndef CACHELAB_SHADOW_H
+#define CACHELAB_SHADOW_H
+
+/* Outcome of a shadow access */
+#define SHADOW_HIT  0
+#define SHADOW_MISS 1   /* the block was seen before but has been evicted */
+#define SHADOW_COLD 2   /* first reference to the block */
+
+/* A shadow cache; the layout is private to shadow.c */
+typedef struct shadow shadow_t;
+
+/* Allocate an empty shadow of the given number of lines, or NULL */
+shadow_t *shadow_new(unsigned long lines);
+
+/* Release a shadow returned by shadow_new */
+void shadow_free(shadow_t *sh);
+
+/*
+ * shadow_access - Reference a block number (address >> b). Returns
+ *     SHADOW_HIT, SHADOW_MISS or SHADOW_COLD, or -1 if out of memory.
+ */
+int shadow_access(shadow_t *sh, unsigned long long block);
+
+#endif /* CACHELAB_SHADOW_H */
@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -12,12 +13,21 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include "cachelab.h"
+#include "fcyc.h"
+#include "counters.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
 
 /* Maximum array dimension */
 #define MAXN 256
 
+/* The benchmark times the best BENCH_K runs out of at most
+   BENCH_SAMPLES, reading BENCH_FLUSH bytes before each run so that it
+   starts with cold caches, as the simulated cache does */
+#define BENCH_K 5
+#define BENCH_SAMPLES 100
+#define BENCH_FLUSH (32 << 20)
+
 /* The description string for the transpose_submit() function that the
    student submits for credit */
 #define SUBMIT_DESCRIPTION "Transpose submission"
@@ -32,6 +42,12 @@ extern int func_counter;
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int bench = 0;
+static int in_process = 0;
+
+/* The matrices for the native runs, laid out as in tracegen */
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -47,17 +63,13 @@ static struct results results = {-1, 0, INT_MAX};
 void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 {
     int i,flag;
-    unsigned int len, hits, misses, evictions;
+    unsigned int hits, misses, evictions, len;
     unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
-    char filename[128];
+    char cmd[255], buf[1000];
+    FILE *trace_fp, *csim_fp;
 
     registerFunctions(); 
 
-    /* Open the complete trace file */
-    FILE* full_trace_fp;  
-    FILE* part_trace_fp; 
-
     /* Evaluate the performance of each registered transpose function */
 
     for (i=0; i<func_counter; i++) {
@@ -65,23 +77,17 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.funcid = i; /* remember which function is the submission */
 
 
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
+        printf("\nFunction %d (%d total)\nStep 1: Validating\n",i,func_counter);
+        /* Check the result natively, which is far quicker than tracing */
 
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
+        sprintf(cmd, "./%s -M %d -N %d -F %d", in_process ? "tracegen" : "tracegen-ref",
+                M, N, i);
         flag=WEXITSTATUS(system(cmd));
         if (0!=flag) {
             printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
             continue;
         }
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
-
-
         func_list[i].correct=1;
 
         /* Save the correctness of the transpose submission */
@@ -89,18 +95,35 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.correct = 1;
         }
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
+        /* Get the start and end marker addresses, before the traced
+           run below rewrites .marker */
+        FILE* marker_fp = fopen(".marker", "r");
+        assert(marker_fp);
+        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
+        fclose(marker_fp);
 
+        /* Stream the trace into the reference simulator. tracegen-ref
+           is not position independent, so the marker addresses the
+           validation run wrote to .marker are the ones it has under
+           valgrind. With -i tracegen records the marker region itself
+           instead. */
+        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
+        unlink(".csim_results");
+        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t /dev/stdin > /dev/null",
+                s, E, b);
+        csim_fp = popen(cmd, "w");
+        assert(csim_fp);
+        if (in_process)
+            sprintf(cmd, "./tracegen -M %d -N %d -F %d -t -", M, N, i);
+        else
+            sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v "
+                    "./tracegen-ref -M %d -N %d -F %d", M, N, i);
+        trace_fp = popen(cmd, "r");
+        assert(trace_fp);
 
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
         /* Locate trace corresponding to the trans function */
         flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
+        while (fgets(buf, 1000, trace_fp) != NULL) {
 
             /* We are only interested in memory access instructions */
             if (buf[0]==' ' && buf[2]==' ' &&
@@ -121,25 +144,16 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
                    eliminate the valgrind stack references while
                    include the student stack references. */
                 if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
+                    fputs(buf, csim_fp);
                 }
 
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
+                /* Past the end marker, only drain the rest of the output */
+                if (addr == marker_end)
                     flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
             }
         }
-        fclose(full_trace_fp);
-
-        /* Run the reference simulator */
-        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
+        pclose(trace_fp);
+        pclose(csim_fp);
     
         /* Collect results from the reference simulator */
         FILE* in_fp = fopen(".csim_results","r");
@@ -160,13 +174,89 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
   
 }
 
+/*
+ * run_func - Run transpose function *argp natively on A and B
+ */
+static void run_func(void *argp)
+{
+    int i = *(int *)argp;
+
+    func_list[i].func_ptr(M, N, (int (*)[M])A, (int (*)[N])B);
+}
+
+/* Smallest count of each hardware event over the runs, -1 if none */
+static long long counts[NUM_COUNTERS];
+
+/*
+ * count_func - run_func between counters_start and counters_stop
+ */
+static void count_func(void *argp)
+{
+    long long v[NUM_COUNTERS];
+    int k;
+
+    counters_start();
+    run_func(argp);
+    counters_stop(v);
+    for (k = 0; k < NUM_COUNTERS; k++)
+        if (counts[k] < 0 || v[k] < counts[k])
+            counts[k] = v[k];
+}
+
+/*
+ * eval_bench - Time the correct transpose functions natively with the
+ *     K-best scheme of fcyc, next to their simulated misses
+ */
+void eval_bench(void)
+{
+    int i, k, ncounters;
+
+    set_fcyc_k(BENCH_K);
+    set_fcyc_maxsamples(BENCH_SAMPLES);
+    set_fcyc_epsilon(0.01);
+    set_fcyc_clear_cache(1);
+    set_fcyc_cache_size(BENCH_FLUSH);
+    set_fcyc_cache_block(64);
+    ncounters = counters_open();
+    initMatrix(M, N, (int (*)[M])A, (int (*)[N])B);
+
+    printf("\nNative benchmark (best %d of up to %d runs, caches flushed"
+           " before each)\n", BENCH_K, BENCH_SAMPLES);
+    if (ncounters == 0)
+        printf("No hardware counters: perf_event_open is not available\n");
+    printf("%4s %8s %11s", "func", "misses", "cycles/elem");
+    for (k = 0; k < NUM_COUNTERS; k++)
+        printf(" %9s", counter_name(k));
+    printf("  %s\n", "description");
+
+    for (i = 0; i < func_counter; i++) {
+        if (!func_list[i].correct)
+            continue;
+        printf("%4d %8u %11.2f", i, func_list[i].num_misses,
+               fcyc(run_func, &i) / ((double)M * N));
+        for (k = 0; k < NUM_COUNTERS; k++)
+            counts[k] = -1;
+        if (ncounters > 0)
+            fcyc(count_func, &i);
+        for (k = 0; k < NUM_COUNTERS; k++)
+            if (counts[k] < 0)
+                printf(" %9s", "-");
+            else
+                printf(" %9lld", counts[k]);
+        printf("  %s\n", func_list[i].description);
+    }
+    counters_close();
+}
+
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hbi] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -b          Also time each correct function natively.\n");
+    printf("  -i          Trace in process with tracegen's hooks, not valgrind.\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
@@ -199,7 +289,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:bhi")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +297,12 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'b':
+            bench = 1;
+            break;
+        case 'i':
+            in_process = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -228,6 +324,11 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    if (!in_process && system("valgrind --version > /dev/null 2>&1") != 0) {
+        printf("Error: valgrind is not on the PATH; -i traces without it\n");
+        exit(1);
+    }
+
     /* Install SIGSEGV and SIGALRM handlers */
     if (signal(SIGSEGV, sigsegv_handler) == SIG_ERR) {
         fprintf(stderr, "Unable to install SIGALRM handler\n");
@@ -244,6 +345,8 @@ int main(int argc, char* argv[])
 
     /* Check the performance of the student's transpose function */
     eval_perf(5, 1, 5);
+    if (bench)
+        eval_bench();
   
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
@@ -0,0 +1,148 @@
+/*
+ * tiled.c - A blocked transpose with its tiling chosen at run time
+ *
+ * tracegen -T runs transpose_tiled under a tiling given on the command
+ * line, so tune-trans can measure every candidate with the same
+ * tracegen and csim pipeline test-trans uses, and tiling_emit prints the
+ * winner as a function with the tiling and the matrix size built in.
+ * The two must walk A and B in the same order; the only difference is
+ * that transpose_tiled reads the tiling from a global first.
+ *
+ * Like trans.c this is compiled with -O0, so the locals stay on the
+ * stack, which the trace filter drops, and every access to A and B in
+ * the source appears in the trace.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "tiled.h"
+
+tiling_t tiling = {8, 8, DIAG_DEFER};
+
+static const char *diag_names[NUM_DIAG] = {"plain", "defer", "row"};
+
+const char *tiling_diag_name(int diag)
+{
+    return diag_names[diag];
+}
+
+int tiling_parse(const char *spec, tiling_t *t)
+{
+    char name[16];
+    int d;
+
+    if (sscanf(spec, "%dx%d:%15s", &t->h, &t->w, name) != 3 ||
+        t->h < 1 || t->w < 1)
+        return -1;
+    for (d = 0; d < NUM_DIAG; d++)
+        if (strcmp(name, diag_names[d]) == 0)
+            break;
+    if (d == NUM_DIAG || (d == DIAG_ROW && t->w > TILED_MAX_W))
+        return -1;
+    t->diag = d;
+    return 0;
+}
+
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N])
+{
+    int h = tiling.h, w = tiling.w, diag = tiling.diag;
+    int ii, jj, i, j, d, dj;
+    int row[TILED_MAX_W];
+
+    for (ii = 0; ii < N; ii += h) {
+        for (jj = 0; jj < M; jj += w) {
+            for (i = ii; i < ii + h && i < N; i++) {
+                if (diag == DIAG_PLAIN) {
+                    for (j = jj; j < jj + w && j < M; j++)
+                        B[j][i] = A[i][j];
+                }
+                else if (diag == DIAG_DEFER) {
+                    dj = -1;
+                    d = 0;
+                    for (j = jj; j < jj + w && j < M; j++) {
+                        if (i == j) {
+                            dj = j;
+                            d = A[i][j];
+                        }
+                        else
+                            B[j][i] = A[i][j];
+                    }
+                    if (dj >= 0)
+                        B[dj][i] = d;
+                }
+                else {
+                    for (j = jj; j < jj + w && j < M; j++)
+                        row[j - jj] = A[i][j];
+                    for (j = jj; j < jj + w && j < M; j++)
+                        B[j][i] = row[j - jj];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * emit_row_guard - Indent the DIAG_ROW statement for column jj + k.
+ *     The last tile can stop short of that column only when w does not
+ *     divide M, so only then is the statement guarded.
+ */
+static void emit_row_guard(FILE *fp, int M, int w, int k)
+{
+    fprintf(fp, "\t\t\t\t");
+    if (k > 0 && M % w != 0)
+        fprintf(fp, "if (jj + %d < %d)\n\t\t\t\t\t", k, M);
+}
+
+void tiling_emit(FILE *fp, const char *name, int M, int N, const tiling_t *t)
+{
+    char col[16];
+    int k;
+
+    fprintf(fp, "void %s(int M, int N, int A[N][M], int B[M][N])\n{\n", name);
+    if (t->diag == DIAG_ROW) {
+        /* The lab allows no arrays, so the row lives in t0, t1, ... */
+        fprintf(fp, "\tint ii, jj, i");
+        for (k = 0; k < t->w; k++)
+            fprintf(fp, ", t%d", k);
+        fprintf(fp, ";\n");
+    }
+    else
+        fprintf(fp, "\tint ii, jj, i, j%s;\n",
+                t->diag == DIAG_DEFER ? ", d, dj" : "");
+    fprintf(fp, "\n\tfor (ii = 0; ii < %d; ii += %d) {\n", N, t->h);
+    fprintf(fp, "\t\tfor (jj = 0; jj < %d; jj += %d) {\n", M, t->w);
+    fprintf(fp, "\t\t\tfor (i = ii; i < ii + %d && i < %d; i++) {\n", t->h, N);
+    switch (t->diag) {
+    case DIAG_PLAIN:
+        fprintf(fp, "\t\t\t\tfor (j = jj; j < jj + %d && j < %d; j++)\n"
+                "\t\t\t\t\tB[j][i] = A[i][j];\n", t->w, M);
+        break;
+    case DIAG_DEFER:
+        fprintf(fp, "\t\t\t\tdj = -1;\n"
+                "\t\t\t\td = 0;\n"
+                "\t\t\t\tfor (j = jj; j < jj + %d && j < %d; j++) {\n"
+                "\t\t\t\t\tif (i == j) {\n"
+                "\t\t\t\t\t\tdj = j;\n"
+                "\t\t\t\t\t\td = A[i][j];\n"
+                "\t\t\t\t\t}\n"
+                "\t\t\t\t\telse\n"
+                "\t\t\t\t\t\tB[j][i] = A[i][j];\n"
+                "\t\t\t\t}\n"
+                "\t\t\t\tif (dj >= 0)\n"
+                "\t\t\t\t\tB[dj][i] = d;\n", t->w, M);
+        break;
+    default:
+        /* Same order as transpose_tiled: the whole row of A, then B */
+        for (k = 0; k < t->w; k++) {
+            snprintf(col, sizeof(col), k ? "jj + %d" : "jj", k);
+            emit_row_guard(fp, M, t->w, k);
+            fprintf(fp, "t%d = A[i][%s];\n", k, col);
+        }
+        for (k = 0; k < t->w; k++) {
+            snprintf(col, sizeof(col), k ? "jj + %d" : "jj", k);
+            emit_row_guard(fp, M, t->w, k);
+            fprintf(fp, "B[%s][i] = t%d;\n", col, k);
+        }
+        break;
+    }
+    fprintf(fp, "\t\t\t}\n\t\t}\n\t}\n}\n");
+}
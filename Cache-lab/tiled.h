@@ -0,0 +1,51 @@
+/*
+ * tiled.h - Prototypes for the blocked transpose whose tile shape and
+ *     diagonal handling are chosen at run time, which tune-trans
+ *     searches over
+ */
+
+#ifndef CACHELAB_TILED_H
+#define CACHELAB_TILED_H
+
+#include <stdio.h>
+
+/* How a tile treats the elements that A and B may fight over */
+#define DIAG_PLAIN 0   /* B[j][i] = A[i][j] one element at a time */
+#define DIAG_DEFER 1   /* write the diagonal element after the rest of its row */
+#define DIAG_ROW   2   /* copy each tile row of A to scalars, then write B */
+#define NUM_DIAG   3
+
+/*
+ * Widest tile DIAG_ROW can buffer: the emitted kernel holds a row in
+ * one scalar per column, and with ii, jj and i that must stay within
+ * the lab's limit of 12 int locals
+ */
+#define TILED_MAX_W 8
+
+typedef struct tiling {
+    int h, w;                   /* tile rows of A and columns of A */
+    int diag;
+} tiling_t;
+
+/* The parameters transpose_tiled runs with */
+extern tiling_t tiling;
+
+/*
+ * tiling_parse - Read a tiling written as <h>x<w>:<diag>, for example
+ *     8x8:defer. Returns -1 if spec is not a valid tiling.
+ */
+int tiling_parse(const char *spec, tiling_t *t);
+
+/* Name of a DIAG_* strategy */
+const char *tiling_diag_name(int diag);
+
+/* transpose_tiled - Transpose A into B with the tiling in tiling */
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * tiling_emit - Write the C source of a function called name that does
+ *     what transpose_tiled does under t, specialized for M and N
+ */
+void tiling_emit(FILE *fp, const char *name, int M, int N, const tiling_t *t);
+
+#endif /* CACHELAB_TILED_H */
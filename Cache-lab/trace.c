@@ -0,0 +1,442 @@
+/*
+ * trace.c - Memory trace reader for the cache simulator
+ *
+ * The trace file is mapped into memory and decoded in place, so no
+ * bytes are copied through stdio. Each record has the form
+ *
+ *     [space]op addr,size
+ *
+ * where op is one of I, L, S, M and addr is in hex. Addresses are
+ * decoded with a table driven scanner; the rest of a line, and any
+ * line that is not a record, is skipped with memchr(), which glibc
+ * implements with SSE2/AVX2 so the skip runs at memory bandwidth.
+ *
+ * Binary traces (see trace.h) are recognized by their magic header and
+ * decoded from the same mapping.
+ *
+ * Standard input ("-") and other files that cannot be mapped, such as a
+ * pipe from valgrind, are read into a buffer that is refilled with
+ * read() as it drains. The decoders only look at the complete lines (or
+ * whole binary records) in the buffer, so a partial line at the end is
+ * kept for the next refill.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+/* Size of the read buffer for streamed traces */
+#define STREAM_BUF (1 << 20)
+
+/* Progress through the marker region */
+#define REGION_UNKNOWN 0    /* marker file not read yet */
+#define REGION_BEFORE  1
+#define REGION_INSIDE  2
+#define REGION_AFTER   3
+
+/* Only data addresses below this are kept inside the marker region */
+#define REGION_ADDR_LIMIT 0xffffffffULL
+
+struct trace {
+    char *map;          /* start of the mapping (NULL if empty) */
+    size_t len;         /* length of the mapping */
+    const char *cur;    /* next byte to decode */
+    const char *end;    /* one past the last byte that may be decoded */
+    const char *lim;    /* one past the last byte held */
+    int binary;         /* nonzero for a binary trace */
+    trace_enc_t dec;    /* delta decoder state for binary traces */
+    int fd;             /* stream being read, or -1 for a mapping */
+    int eof;            /* the stream has ended */
+    char *buf;          /* STREAM_BUF bytes of stream data */
+    const char *marker_path;
+    int region;
+    int all_regions;    /* look for another region after the end marker */
+    int nregions;       /* start markers seen */
+    unsigned long long marker_start, marker_end;
+};
+
+/* Binary op codes, indexed by the low two bits of a record */
+static const char bin_ops[4] = {'I', 'L', 'S', 'M'};
+
+/* Value of each hex digit plus one; zero marks a non-digit */
+static const unsigned char hex_tab[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/*
+ * set_window - Let the decoders run up to the last complete line, or for
+ *     binary traces up to where a whole record is certain to be held
+ */
+static void set_window(trace_t *t)
+{
+    const char *nl;
+
+    if (t->eof)
+        t->end = t->lim;
+    else if (t->binary)
+        t->end = t->lim - t->cur > TRACE_BIN_MAXREC ?
+            t->lim - TRACE_BIN_MAXREC : t->cur;
+    else if ((nl = memrchr(t->cur, '\n', t->lim - t->cur)) != NULL)
+        t->end = nl + 1;
+    else    /* no newline in a full buffer: give up on the line */
+        t->end = t->lim - t->cur == STREAM_BUF ? t->lim : t->cur;
+}
+
+/*
+ * refill - Keep the undecoded bytes and read more of the stream behind
+ *     them. Returns 0 once the stream has ended and everything is held.
+ */
+static int refill(trace_t *t)
+{
+    size_t keep = t->lim - t->cur;
+    ssize_t n;
+
+    if (t->eof)
+        return 0;
+    memmove(t->buf, t->cur, keep);
+    t->cur = t->buf;
+    t->lim = t->buf + keep;
+    do
+        n = read(t->fd, t->buf + keep, STREAM_BUF - keep);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        t->eof = 1;
+    else
+        t->lim += n;
+    set_window(t);
+    return 1;
+}
+
+/*
+ * open_stream - Set up the read buffer for a trace that is not mapped
+ */
+static int open_stream(trace_t *t, int fd)
+{
+    if ((t->buf = malloc(STREAM_BUF)) == NULL)
+        return -1;
+    t->fd = fd;
+    t->cur = t->lim = t->end = t->buf;
+    while (!t->eof && t->lim - t->buf < TRACE_BIN_MAGIC_LEN)
+        refill(t);
+    if (t->lim - t->buf >= TRACE_BIN_MAGIC_LEN &&
+        memcmp(t->buf, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN) == 0) {
+        t->binary = 1;
+        t->cur += TRACE_BIN_MAGIC_LEN;
+        trace_enc_init(&t->dec);
+    }
+    set_window(t);
+    return 0;
+}
+
+/*
+ * trace_open - Map the trace file read-only and advise the kernel
+ *     that it will be read sequentially, or stream it if it cannot be
+ *     mapped
+ */
+trace_t *trace_open(const char *path)
+{
+    struct stat st;
+    trace_t *t;
+    int fd, err;
+
+    if (strcmp(path, "-") == 0)
+        fd = STDIN_FILENO;
+    else if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0)
+        goto fail;
+    if ((t = calloc(1, sizeof(trace_t))) == NULL)
+        goto fail;
+    t->fd = -1;
+    if (!S_ISREG(st.st_mode)) {
+        if (open_stream(t, fd) < 0) {
+            free(t);
+            goto fail;
+        }
+        return t;
+    }
+    t->len = st.st_size;
+    if (t->len > 0) {
+        t->map = mmap(NULL, t->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (t->map == MAP_FAILED) {
+            free(t);
+            goto fail;
+        }
+        madvise(t->map, t->len, MADV_SEQUENTIAL);
+    }
+    if (fd != STDIN_FILENO)
+        close(fd);
+    t->cur = t->map;
+    t->end = t->lim = t->map + t->len;
+    t->eof = 1;
+    if (t->len >= TRACE_BIN_MAGIC_LEN &&
+        memcmp(t->map, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN) == 0) {
+        t->binary = 1;
+        t->cur += TRACE_BIN_MAGIC_LEN;
+        trace_enc_init(&t->dec);
+    }
+    return t;
+
+fail:
+    err = errno;
+    if (fd != STDIN_FILENO)
+        close(fd);
+    errno = err;
+    return NULL;
+}
+
+/*
+ * load_markers - Read the marker addresses, if the file exists yet
+ */
+static void load_markers(trace_t *t)
+{
+    FILE *fp = fopen(t->marker_path, "r");
+
+    if (fp == NULL)
+        return;
+    if (fscanf(fp, "%llx %llx", &t->marker_start, &t->marker_end) == 2)
+        t->region = REGION_BEFORE;
+    fclose(fp);
+}
+
+/*
+ * trace_set_markers - Restrict the trace to the marker region(s)
+ */
+void trace_set_markers(trace_t *t, const char *marker_path, int all)
+{
+    t->marker_path = marker_path;
+    t->region = REGION_UNKNOWN;
+    t->all_regions = all;
+    t->nregions = 0;
+    load_markers(t);
+}
+
+/*
+ * trace_region - Number of the region of the last record
+ */
+int trace_region(const trace_t *t)
+{
+    return t->nregions - 1;
+}
+
+/*
+ * get_varint - Decode an unsigned LEB128 value, stopping at end on a
+ *     truncated trace
+ */
+static inline unsigned long long get_varint(const unsigned char **pp,
+                                            const unsigned char *end)
+{
+    const unsigned char *p = *pp;
+    unsigned long long v = 0;
+    int shift = 0;
+
+    while (p < end) {
+        v |= (unsigned long long)(*p & 0x7f) << shift;
+        shift += 7;
+        if (!(*p++ & 0x80))
+            break;
+    }
+    *pp = p;
+    return v;
+}
+
+/*
+ * put_varint - Encode v as unsigned LEB128 and return the byte count
+ */
+static inline int put_varint(unsigned char *buf, unsigned long long v)
+{
+    int n = 0;
+
+    while (v >= 0x80) {
+        buf[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (unsigned char)v;
+    return n;
+}
+
+/*
+ * next_binary - Decode one binary record. The first byte holds the op
+ *     code, the size-changed flag and the low four bits of the zigzag
+ *     delta; its high bit says the rest of the delta follows.
+ */
+static int next_binary(trace_t *t, trace_rec_t *rec)
+{
+    const unsigned char *p = (const unsigned char *)t->cur;
+    const unsigned char *end = (const unsigned char *)t->end;
+    const unsigned char *lim = (const unsigned char *)t->lim;
+    unsigned long long zz;
+    unsigned int b0;
+    int d;
+
+    if (p >= end)
+        return 0;
+    b0 = *p++;
+    zz = (b0 >> 3) & 0xf;
+    if (b0 & 0x80)
+        zz |= get_varint(&p, lim) << 4;
+    if (b0 & 0x4)
+        t->dec.prev_size = (unsigned int)get_varint(&p, lim);
+    rec->op = bin_ops[b0 & 0x3];
+    d = rec->op != 'I';
+    t->dec.prev_addr[d] += (zz >> 1) ^ -(zz & 1);
+    rec->addr = t->dec.prev_addr[d];
+    rec->size = t->dec.prev_size;
+    t->cur = (const char *)p;
+    return 1;
+}
+
+/*
+ * next_text - Decode the next memory record held in the buffer, skipping
+ *     any line that does not parse as one
+ */
+static int next_text(trace_t *t, trace_rec_t *rec)
+{
+    const char *p = t->cur, *end = t->end, *nl;
+    unsigned long long addr;
+    unsigned int size, d;
+    char op;
+
+    while (p < end) {
+        while (p < end && *p == ' ')
+            p++;
+        if (end - p > 2 && p[1] == ' ' &&
+            (*p == 'I' || *p == 'L' || *p == 'S' || *p == 'M')) {
+            op = *p;
+            p += 2;
+            while (p < end && *p == ' ')
+                p++;
+            addr = 0;
+            if (p < end && hex_tab[(unsigned char)*p]) {
+                while (p < end && (d = hex_tab[(unsigned char)*p])) {
+                    addr = (addr << 4) | (d - 1);
+                    p++;
+                }
+                if (p < end && *p == ',') {
+                    size = 0;
+                    for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+                        size = size * 10 + (*p - '0');
+                    nl = memchr(p, '\n', end - p);
+                    t->cur = nl ? nl + 1 : end;
+                    rec->op = op;
+                    rec->addr = addr;
+                    rec->size = size;
+                    return 1;
+                }
+            }
+        }
+        nl = memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end;
+    }
+    t->cur = end;
+    return 0;
+}
+
+/*
+ * next_raw - Decode the next record, refilling a streamed trace as needed
+ */
+static inline int next_raw(trace_t *t, trace_rec_t *rec)
+{
+    for (;;) {
+        if (t->binary ? next_binary(t, rec) : next_text(t, rec))
+            return 1;
+        if (t->fd < 0 || !refill(t))
+            return 0;
+        /* The marker file is written before the store to the start
+           marker, so it exists by the time that record has been read */
+        if (t->region == REGION_UNKNOWN && t->marker_path != NULL)
+            load_markers(t);
+    }
+}
+
+/*
+ * trace_next - Decode the next record, keeping to the marker region if
+ *     one was set
+ */
+int trace_next(trace_t *t, trace_rec_t *rec)
+{
+    if (t->marker_path == NULL)
+        return next_raw(t, rec);
+    while (t->region != REGION_AFTER && next_raw(t, rec)) {
+        if (rec->op == 'I') {
+            if (t->region == REGION_INSIDE)
+                return 1;
+            continue;
+        }
+        if (t->region == REGION_UNKNOWN)
+            continue;
+        if (rec->addr == t->marker_start && t->region == REGION_BEFORE) {
+            t->region = REGION_INSIDE;
+            t->nregions++;
+        }
+        if (t->region != REGION_INSIDE)
+            continue;
+        if (rec->addr == t->marker_end)
+            t->region = t->all_regions ? REGION_BEFORE : REGION_AFTER;
+        if (rec->addr < REGION_ADDR_LIMIT)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * trace_close - Unmap or stop reading the trace and free its handle
+ */
+void trace_close(trace_t *t)
+{
+    if (t->map)
+        munmap(t->map, t->len);
+    if (t->fd > STDIN_FILENO)
+        close(t->fd);
+    free(t->buf);
+    free(t);
+}
+
+/*
+ * trace_enc_init - Start a binary trace with both address predictors
+ *     and the size at zero
+ */
+void trace_enc_init(trace_enc_t *enc)
+{
+    memset(enc, 0, sizeof(*enc));
+}
+
+/*
+ * trace_encode - Append the binary form of rec to buf, updating the
+ *     delta state in enc
+ */
+int trace_encode(trace_enc_t *enc, const trace_rec_t *rec, unsigned char *buf)
+{
+    int d = rec->op != 'I', n = 1;
+    long long delta = (long long)(rec->addr - enc->prev_addr[d]);
+    unsigned long long zz = ((unsigned long long)delta << 1) ^ (delta >> 63);
+    unsigned int op;
+
+    switch (rec->op) {
+    case 'I': op = 0; break;
+    case 'L': op = 1; break;
+    case 'S': op = 2; break;
+    default:  op = 3; break;
+    }
+    buf[0] = (unsigned char)(op | (zz & 0xf) << 3);
+    if (zz >> 4) {
+        buf[0] |= 0x80;
+        n += put_varint(buf + n, zz >> 4);
+    }
+    if (rec->size != enc->prev_size) {
+        buf[0] |= 0x4;
+        n += put_varint(buf + n, rec->size);
+        enc->prev_size = rec->size;
+    }
+    enc->prev_addr[d] = rec->addr;
+    return n;
+}
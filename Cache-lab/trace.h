@@ -0,0 +1,82 @@
+/*
+ * trace.h - Prototypes for the memory trace reader used by the cache
+ *     simulator
+ */
+
+#ifndef CACHELAB_TRACE_H
+#define CACHELAB_TRACE_H
+
+/* One memory access record from a valgrind lackey style trace */
+typedef struct trace_rec {
+    char op;                   /* 'I', 'L', 'S' or 'M' */
+    unsigned int size;         /* number of bytes accessed */
+    unsigned long long addr;   /* address of the access */
+} trace_rec_t;
+
+/*
+ * Binary traces start with TRACE_BIN_MAGIC. Each record begins with a
+ * byte holding the op code (bits 0-1), a size-changed flag (bit 2) and
+ * the low four bits of the zigzag encoded address delta (bits 3-6).
+ * Bit 7 says the rest of the delta follows as a LEB128 varint, and a
+ * varint size follows when the flag is set. Instruction and data
+ * addresses are delta encoded against separate predecessors.
+ */
+#define TRACE_BIN_MAGIC "CSIMBT1\n"
+#define TRACE_BIN_MAGIC_LEN 8
+
+/* Longest encoding of one binary record in bytes */
+#define TRACE_BIN_MAXREC 15
+
+/* Encoder state for writing a binary trace */
+typedef struct trace_enc {
+    unsigned long long prev_addr[2];   /* last instruction, data address */
+    unsigned int prev_size;
+} trace_enc_t;
+
+/* An open trace; the layout is private to trace.c */
+typedef struct trace trace_t;
+
+/*
+ * trace_open - Map the trace file at path for reading. Text and binary
+ *     traces are told apart by the magic header. A path of "-" reads
+ *     standard input, and pipes are read as a stream rather than mapped.
+ *     Returns NULL and sets errno on failure.
+ */
+trace_t *trace_open(const char *path);
+
+/*
+ * trace_set_markers - Keep only the region test-trans cuts out of a
+ *     tracegen trace: the data records from the access to the start
+ *     marker through the access to the end marker, with addresses below
+ *     0xffffffff, plus the instruction records between them. If all is
+ *     set, every such region is kept (tracegen without -F makes one per
+ *     transpose function), else the trace ends with the first. The two
+ *     hex marker addresses are read from marker_path now, or, if tracegen
+ *     is still running and has yet to write it, after each read of a
+ *     streamed trace until it appears.
+ */
+void trace_set_markers(trace_t *t, const char *marker_path, int all);
+
+/* trace_region - Number of the marker region, from 0, of the last record */
+int trace_region(const trace_t *t);
+
+/*
+ * trace_next - Decode the next record into rec. Returns 1 on success
+ *     and 0 once the trace is exhausted. Lines that are not memory
+ *     records are skipped.
+ */
+int trace_next(trace_t *t, trace_rec_t *rec);
+
+/* Release a trace returned by trace_open */
+void trace_close(trace_t *t);
+
+/* Reset an encoder before writing the first record of a binary trace */
+void trace_enc_init(trace_enc_t *enc);
+
+/*
+ * trace_encode - Write the binary encoding of rec into buf, which must
+ *     hold TRACE_BIN_MAXREC bytes. Returns the number of bytes written.
+ */
+int trace_encode(trace_enc_t *enc, const trace_rec_t *rec, unsigned char *buf);
+
+#endif /* CACHELAB_TRACE_H */
@@ -1,10 +1,17 @@
 /* 
- * tracegen.c - Running the binary tracegen with valgrind produces
- * a memory trace of all of the registered transpose functions. 
+ * tracegen.c - Running the binary tracegen with -t produces a memory
+ * trace of all of the registered transpose functions. 
  * 
  * The beginning and end of each registered transpose function's trace
- * is indicated by reading from "marker" addresses. These two marker
+ * is indicated by writing to "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * test-trans traces tracegen-ref, built from this source as it always
+ * was, under valgrind's lackey tool. tracegen is built with the
+ * memtrace.c access hooks as well, and with -t writes the records from
+ * the start marker through the end marker itself, in lackey's format,
+ * at native speed (test-trans -i). Without -t it only validates the
+ * functions.
  */
 
 #include <stdlib.h>
@@ -13,6 +20,8 @@
 #include <unistd.h>
 #include <getopt.h>
 #include "cachelab.h"
+#include "tiled.h"
+#include "memtrace.h"
 #include <string.h>
 
 /* External variables declared in cachelab.c */
@@ -30,6 +39,24 @@ static int B[256][256];
 static int M;
 static int N;
 
+/*
+ * start_region, end_region - Store to the markers, and when tracing
+ *     record the stores and every access between them. The flag is an
+ *     argument, since a load of a global here would land in the trace.
+ */
+static void start_region(int tracing)
+{
+    if (tracing)
+        memtrace_on();
+    MARKER_START = 33;
+}
+
+static void end_region(int tracing)
+{
+    MARKER_END = 34;
+    if (tracing)
+        memtrace_off();
+}
 
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     int C[M][N];
@@ -50,8 +77,9 @@ int main(int argc, char* argv[]){
     int i;
 
     char c;
-    int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    int selectedFunc=-1, tiled=0, status=0, tracing=0;
+    char *tracefile=NULL;
+    while( (c=getopt(argc,argv,"M:N:F:T:t:")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +90,18 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'T':
+            /* Run transpose_tiled under this tiling instead */
+            if (tiling_parse(optarg, &tiling) < 0) {
+                printf("./tracegen: bad tiling %s\n", optarg);
+                exit(1);
+            }
+            tiled=1;
+            break;
+        case 't':
+            /* Write the trace to this file ("-" for stdout) */
+            tracefile = optarg;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -84,24 +124,45 @@ int main(int argc, char* argv[]){
             (unsigned long long int) &MARKER_END );
     fclose(marker_fp);
 
-    if (-1==selectedFunc) {
+    if (tracefile) {
+        if (memtrace_open(tracefile) < 0) {
+            printf("./tracegen: cannot create %s\n", tracefile);
+            exit(1);
+        }
+        tracing=1;
+    }
+
+    if (tiled) {
+        start_region(tracing);
+        transpose_tiled(M, N, A, B);
+        end_region(tracing);
+        if (!validate(0,M,N,A,B))
+            status = 1;
+    } else if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
+            start_region(tracing);
             (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
-                return i+1;
+            end_region(tracing);
+            if (!validate(i,M,N,A,B)) {
+                status = i+1;
+                break;
+            }
         }
     } else {
-        MARKER_START = 33;
+        start_region(tracing);
         (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
+        end_region(tracing);
         if (!validate(selectedFunc,M,N,A,B))
-            return selectedFunc+1;
+            status = selectedFunc+1;
+
+    }
 
+    if (tracing && memtrace_close() < 0) {
+        printf("./tracegen: error writing %s\n", tracefile);
+        exit(1);
     }
-    return 0;
+    return status;
 }
 
 
@@ -0,0 +1,96 @@
+/*
+ * tracepack.c - Convert memory traces between the valgrind lackey text
+ *     format and the packed binary format read by csim.
+ *
+ * The input format is detected automatically, so the same tool packs a
+ * text trace and, with -x, unpacks a binary trace back to text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "trace.h"
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hx] -t <tracefile> -o <outfile>\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -t <file>   Trace to convert (text or binary).\n");
+    printf("  -o <file>   Where to write the converted trace.\n");
+    printf("  -x          Write lackey text instead of the binary format.\n");
+    printf("Example: %s -t traces/trans.trace -o trans.bin\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    char *infile = NULL, *outfile = NULL;
+    unsigned char buf[TRACE_BIN_MAXREC];
+    unsigned long long nrecs = 0;
+    int c, text = 0;
+    trace_enc_t enc;
+    trace_rec_t rec;
+    trace_t *trace;
+    FILE *out;
+
+    while ((c = getopt(argc, argv, "t:o:xh")) != -1) {
+        switch (c) {
+        case 't':
+            infile = optarg;
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case 'x':
+            text = 1;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (infile == NULL || outfile == NULL) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if ((trace = trace_open(infile)) == NULL) {
+        fprintf(stderr, "%s: %s\n", infile, strerror(errno));
+        exit(1);
+    }
+    if ((out = fopen(outfile, "wb")) == NULL) {
+        fprintf(stderr, "%s: %s\n", outfile, strerror(errno));
+        exit(1);
+    }
+
+    if (!text) {
+        fwrite(TRACE_BIN_MAGIC, 1, TRACE_BIN_MAGIC_LEN, out);
+        trace_enc_init(&enc);
+    }
+    while (trace_next(trace, &rec)) {
+        if (text && rec.op == 'I')
+            fprintf(out, "I  %08llx,%u\n", rec.addr, rec.size);
+        else if (text)
+            fprintf(out, " %c %08llx,%u\n", rec.op, rec.addr, rec.size);
+        else
+            fwrite(buf, 1, trace_encode(&enc, &rec, buf), out);
+        nrecs++;
+    }
+    trace_close(trace);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s: %s\n", outfile, strerror(errno));
+        exit(1);
+    }
+    printf("%llu records written to %s\n", nrecs, outfile);
+    return 0;
+}
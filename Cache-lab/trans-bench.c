@@ -0,0 +1,264 @@
+/*
+ * trans-bench.c - Time the transposes natively: the scalar ones from
+ *     trans.c against the SSE2 and AVX2 kernels in trans-simd.c
+ *
+ * Each function runs on one pair of matrices per size until it has
+ * used at least MIN_TIME seconds and MIN_REPS runs, and the fastest run
+ * is reported in nanoseconds per element and in GB/s of A read plus B
+ * written. The first run of each function is checked against A.
+ *
+ * With -j, each size is then run on pools of 1, 2, 4, ... up to the
+ * given number of threads, under both schedules of trans-par.c, with B
+ * either placed by the main thread or first touched by the workers.
+ * B is mapped afresh for every line so the placement is the one named.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "trans-simd.h"
+#include "trans-par.h"
+
+#define DEFAULT_SIZES "256x256,1024x1024,2048x2048,4096x4096,8192x8192"
+#define MIN_TIME 0.25
+#define MIN_REPS 3
+
+/* From trans.c */
+extern char trans_desc[], transpose_oblivious_desc[];
+void trans(int M, int N, int A[N][M], int B[M][N]);
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N]);
+
+typedef struct {
+    void (*func)(int M, int N, int A[N][M], int B[M][N]);
+    const char *name;
+    const char *desc;
+} bench_func;
+
+static const bench_func funcs[] = {
+    {trans, "trans", trans_desc},
+    {transpose_oblivious, "oblivious", transpose_oblivious_desc},
+    {transpose_scalar8, "scalar8", transpose_scalar8_desc},
+    {transpose_sse4x4, "sse4x4", transpose_sse4x4_desc},
+    {transpose_avx8x8, "avx8x8", transpose_avx8x8_desc},
+};
+#define NFUNCS (int)(sizeof(funcs) / sizeof(funcs[0]))
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * check - Return 1 if B is the transpose of A
+ */
+static int check(int M, int N, const int *A, const int *B)
+{
+    int i, j;
+
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (A[(size_t)i * M + j] != B[(size_t)j * N + i])
+                return 0;
+    return 1;
+}
+
+/*
+ * bench - Fastest time of f on the N x M matrix A, or -1 if it is wrong
+ */
+static double bench(const bench_func *f, int M, int N, int *A, int *B)
+{
+    double start, t, best = 1e30;
+    int reps;
+
+    memset(B, 0, sizeof(int) * (size_t)M * N);
+    f->func(M, N, (int (*)[M])A, (int (*)[N])B);
+    if (!check(M, N, A, B))
+        return -1;
+    start = now_sec();
+    for (reps = 0; reps < MIN_REPS || now_sec() - start < MIN_TIME; reps++) {
+        t = now_sec();
+        f->func(M, N, (int (*)[M])A, (int (*)[N])B);
+        t = now_sec() - t;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+/*
+ * bench_pool - Fastest time of pool p transposing A into a fresh B, or
+ *     -1 if the result is wrong
+ */
+static double bench_pool(trans_pool_t *p, int sched, int touch, int M, int N,
+                         int *A)
+{
+    double start, t, best = 1e30;
+    size_t bytes = sizeof(int) * (size_t)M * N;
+    int reps, *B;
+
+    if (posix_memalign((void **)&B, 64, bytes)) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    if (touch)
+        trans_pool_touch(p, M, N, B);
+    else
+        memset(B, 0, bytes);
+    trans_pool_run(p, M, N, (int (*)[M])A, (int (*)[N])B, sched);
+    if (!check(M, N, A, B)) {
+        free(B);
+        return -1;
+    }
+    start = now_sec();
+    for (reps = 0; reps < MIN_REPS || now_sec() - start < MIN_TIME; reps++) {
+        t = now_sec();
+        trans_pool_run(p, M, N, (int (*)[M])A, (int (*)[N])B, sched);
+        t = now_sec() - t;
+        if (t < best)
+            best = t;
+    }
+    free(B);
+    return best;
+}
+
+/*
+ * scaling - Print GB/s of the pools from 1 to maxthreads threads
+ */
+static int scaling(int M, int N, int *A, int maxthreads)
+{
+    static const char *sched_names[] = {"static", "steal"};
+    double t, base[2][2] = {{0, 0}, {0, 0}};
+    int n, sched, touch, status = 0;
+    trans_pool_t *p;
+
+    for (n = 1;; n = 2 * n < maxthreads ? 2 * n : maxthreads) {
+        if ((p = trans_pool_new(n, 1)) == NULL) {
+            fprintf(stderr, "Error: cannot start %d threads\n", n);
+            exit(1);
+        }
+        for (sched = TRANS_STATIC; sched <= TRANS_STEAL; sched++)
+            for (touch = 0; touch < 2; touch++) {
+                if ((t = bench_pool(p, sched, touch, M, N, A)) < 0) {
+                    printf("%5dx%-5d %7d %-6s %-5s wrong result\n", M, N, n,
+                           sched_names[sched], touch ? "yes" : "no");
+                    status = 1;
+                    continue;
+                }
+                if (n == 1)
+                    base[sched][touch] = t;
+                printf("%5dx%-5d %7d %-6s %-5s %10.2f", M, N, n,
+                       sched_names[sched], touch ? "yes" : "no",
+                       2.0 * sizeof(int) * M * N / t / 1e9);
+                /* No scaling if the 1 thread run gave a wrong result */
+                if (base[sched][touch] > 0)
+                    printf(" %7.2fx\n", base[sched][touch] / t);
+                else
+                    printf(" %8s\n", "-");
+            }
+        trans_pool_free(p);
+        if (n == maxthreads)
+            break;
+    }
+    return status;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    int i;
+
+    printf("Usage: %s [-h] [-d <MxN>[,...]] [-j <threads>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -d <list>  Sizes to time, M columns by N rows of A\n"
+           "             (default %s).\n", DEFAULT_SIZES);
+    printf("  -j <n>     Also time the threaded transpose on 1 to n threads.\n");
+    printf("Functions:\n");
+    for (i = 0; i < NFUNCS; i++)
+        printf("  %-10s %s\n", funcs[i].name, funcs[i].desc);
+}
+
+int main(int argc, char *argv[])
+{
+    char *sizes = DEFAULT_SIZES;
+    int c, M, N, len, i, status = 0, threads = 0;
+    double t, base;
+    size_t bytes;
+    int *A, *B;
+
+    while ((c = getopt(argc, argv, "d:j:h")) != -1) {
+        switch (c) {
+        case 'd':
+            sizes = optarg;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if (threads < 0 || threads > TRANS_MAX_THREADS) {
+        usage(argv);
+        exit(1);
+    }
+
+    printf("%s kernels; time is the best of at least %d runs\n\n",
+           trans_simd_name(), MIN_REPS);
+    printf("%11s %-10s %10s %10s %8s\n", "size", "function", "ns/elem",
+           "GB/s", "speedup");
+    while (sscanf(sizes, "%dx%d%n", &M, &N, &len) == 2) {
+        if (M < 1 || N < 1) {
+            usage(argv);
+            exit(1);
+        }
+        bytes = sizeof(int) * (size_t)M * N;
+        if (posix_memalign((void **)&A, 64, bytes) ||
+            posix_memalign((void **)&B, 64, bytes)) {
+            fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+            exit(1);
+        }
+        for (i = 0; i < M * N; i++)
+            A[i] = rand();
+
+        base = 0;
+        for (i = 0; i < NFUNCS; i++) {
+            if ((t = bench(&funcs[i], M, N, A, B)) < 0) {
+                printf("%5dx%-5d %-10s wrong result\n", M, N, funcs[i].name);
+                status = 1;
+                continue;
+            }
+            if (i == 0)
+                base = t;
+            printf("%5dx%-5d %-10s %10.3f %10.2f %7.2fx\n", M, N, funcs[i].name,
+                   t * 1e9 / ((double)M * N), 2.0 * bytes / t / 1e9, base / t);
+        }
+        printf("\n");
+        free(B);
+        if (threads > 0) {
+            printf("%11s %7s %-6s %-5s %10s %8s\n", "size", "threads", "sched",
+                   "touch", "GB/s", "scaling");
+            status |= scaling(M, N, A, threads);
+            printf("\n");
+        }
+        free(A);
+
+        sizes += len;
+        if (*sizes != ',')
+            break;
+        sizes++;
+    }
+    return status;
+}
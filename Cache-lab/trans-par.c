@@ -0,0 +1,285 @@
+/*
+ * trans-par.c - Multi-threaded blocked transpose
+ *
+ * The unit of work is a band of BAND columns of A, which is a band of
+ * BAND whole rows of B: every unit writes its own contiguous stretch of
+ * B, so the pages of B can be placed by first touch on the node of the
+ * worker that writes them. Each band is transposed with the SIMD
+ * blocked kernels of trans-simd.c.
+ *
+ * Every worker starts a run owning a contiguous share of the bands,
+ * the same share trans_pool_touch gives it. Under TRANS_STATIC that is
+ * all it does. Under TRANS_STEAL a worker that finishes its share takes
+ * the upper half of the unclaimed bands of another. A share is one
+ * 64 bit word holding the first and one-past-last unclaimed band, so
+ * the owner claiming from the bottom and a thief splitting off the top
+ * are both a single compare-and-swap, and no lock is held while
+ * transposing.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "trans-simd.h"
+#include "trans-par.h"
+
+/* Rows of B in one unit of work */
+#define BAND 64
+
+/* Jobs a pool runs */
+#define JOB_TOUCH     0
+#define JOB_TRANSPOSE 1
+
+/* Unclaimed bands lo..hi-1 of one worker, packed as hi << 32 | lo */
+typedef struct {
+    unsigned long long range;
+    char pad[64 - sizeof(unsigned long long)];
+} share_t;
+
+typedef struct {
+    trans_pool_t *pool;
+    int id;
+    pthread_t tid;
+} worker_t;
+
+struct trans_pool {
+    int n, pin;
+    pthread_mutex_t lock;
+    pthread_cond_t go, idle;
+    unsigned int gen;           /* bumped to start each job */
+    int active;                 /* workers still on the current job */
+    int quit;
+    /* The current job */
+    int job, M, N, sched;
+    int *A, *B;
+    worker_t worker[TRANS_MAX_THREADS];
+    share_t share[TRANS_MAX_THREADS];
+};
+
+/*
+ * pin - Bind the calling thread to the i-th CPU it may run on, counting
+ *     round the allowed set
+ */
+static void pin(int i)
+{
+    cpu_set_t allowed, one;
+    int cpu, n = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0 ||
+        CPU_COUNT(&allowed) == 0)
+        return;
+    i %= CPU_COUNT(&allowed);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || n++ < i)
+            continue;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+        return;
+    }
+}
+
+static inline unsigned long long pack(unsigned long long lo,
+                                      unsigned long long hi)
+{
+    return hi << 32 | lo;
+}
+
+/*
+ * band - Transpose band u, or zero its rows of B for JOB_TOUCH
+ */
+static void band(trans_pool_t *p, unsigned long long u)
+{
+    int M = p->M, N = p->N;
+    int j0 = (int)u * BAND, j1 = j0 + BAND < M ? j0 + BAND : M;
+
+    if (p->job == JOB_TOUCH)
+        memset(p->B + (size_t)j0 * N, 0, sizeof(int) * (size_t)(j1 - j0) * N);
+    else
+        transpose_simd_cols(M, N, (int (*)[M])p->A, (int (*)[N])p->B, j0, j1);
+}
+
+/*
+ * steal - Move the upper half of another worker's share to worker id.
+ *     Returns 0 if no worker has two bands left.
+ */
+static int steal(trans_pool_t *p, int id)
+{
+    unsigned long long r, lo, hi, mid;
+    int k, v;
+
+    for (k = 1; k < p->n; k++) {
+        v = (id + k) % p->n;
+        r = __atomic_load_n(&p->share[v].range, __ATOMIC_ACQUIRE);
+        lo = r & 0xffffffffULL;
+        hi = r >> 32;
+        if (hi < lo + 2)
+            continue;
+        mid = lo + (hi - lo) / 2;
+        if (__atomic_compare_exchange_n(&p->share[v].range, &r, pack(lo, mid),
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&p->share[id].range, pack(mid, hi), __ATOMIC_RELEASE);
+            return 1;
+        }
+        k--;                    /* the victim moved on; look at it again */
+    }
+    return 0;
+}
+
+/*
+ * work - Claim and run bands from the worker's own share, then steal
+ *     more if the job allows it
+ */
+static void work(trans_pool_t *p, int id)
+{
+    unsigned long long r, lo, hi;
+
+    for (;;) {
+        r = __atomic_load_n(&p->share[id].range, __ATOMIC_ACQUIRE);
+        lo = r & 0xffffffffULL;
+        hi = r >> 32;
+        if (lo < hi) {
+            if (__atomic_compare_exchange_n(&p->share[id].range, &r,
+                                            pack(lo + 1, hi), 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                band(p, lo);
+            continue;
+        }
+        if (p->job != JOB_TRANSPOSE || p->sched != TRANS_STEAL || !steal(p, id))
+            return;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    trans_pool_t *p = w->pool;
+    unsigned int seen = 0;
+
+    if (p->pin)
+        pin(w->id);
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->gen == seen && !p->quit)
+            pthread_cond_wait(&p->go, &p->lock);
+        if (p->quit)
+            break;
+        seen = p->gen;
+        pthread_mutex_unlock(&p->lock);
+        work(p, w->id);
+        pthread_mutex_lock(&p->lock);
+        if (--p->active == 0)
+            pthread_cond_signal(&p->idle);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/*
+ * run - Give every worker its static share of the bands of an M x N
+ *     job and wait for all of them to finish
+ */
+static void run(trans_pool_t *p, int job, int M, int N, int *A, int *B,
+                int sched)
+{
+    unsigned long long units = (M + BAND - 1) / BAND;
+    int w;
+
+    pthread_mutex_lock(&p->lock);
+    p->job = job;
+    p->M = M;
+    p->N = N;
+    p->A = A;
+    p->B = B;
+    p->sched = sched;
+    for (w = 0; w < p->n; w++)
+        p->share[w].range = pack(units * w / p->n, units * (w + 1) / p->n);
+    p->active = p->n;
+    p->gen++;
+    pthread_cond_broadcast(&p->go);
+    while (p->active > 0)
+        pthread_cond_wait(&p->idle, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/*
+ * stop - Tell the first n workers to exit, wait for them and free p
+ */
+static void stop(trans_pool_t *p, int n)
+{
+    int w;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->go);
+    pthread_mutex_unlock(&p->lock);
+    for (w = 0; w < n; w++)
+        pthread_join(p->worker[w].tid, NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->go);
+    pthread_cond_destroy(&p->idle);
+    free(p);
+}
+
+trans_pool_t *trans_pool_new(int nthreads, int pin)
+{
+    trans_pool_t *p;
+    int w;
+
+    if (nthreads < 1 || nthreads > TRANS_MAX_THREADS ||
+        (p = calloc(1, sizeof(trans_pool_t))) == NULL)
+        return NULL;
+    p->n = nthreads;
+    p->pin = pin;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->go, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    for (w = 0; w < nthreads; w++) {
+        p->worker[w].pool = p;
+        p->worker[w].id = w;
+        if (pthread_create(&p->worker[w].tid, NULL, worker_main, &p->worker[w])) {
+            stop(p, w);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+void trans_pool_free(trans_pool_t *p)
+{
+    stop(p, p->n);
+}
+
+void trans_pool_touch(trans_pool_t *p, int M, int N, int *B)
+{
+    run(p, JOB_TOUCH, M, N, NULL, B, TRANS_STATIC);
+}
+
+void trans_pool_run(trans_pool_t *p, int M, int N, int A[N][M], int B[M][N],
+                    int sched)
+{
+    run(p, JOB_TRANSPOSE, M, N, &A[0][0], &B[0][0], sched);
+}
+
+static trans_pool_t *default_pool;
+static pthread_once_t default_once = PTHREAD_ONCE_INIT;
+
+static void start_default_pool(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    default_pool = trans_pool_new(n < 1 ? 1 : n > TRANS_MAX_THREADS ?
+                                  TRANS_MAX_THREADS : (int)n, 1);
+}
+
+char transpose_parallel_desc[] = "Multi-threaded blocked transpose";
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N])
+{
+    pthread_once(&default_once, start_default_pool);
+    if (default_pool)
+        trans_pool_run(default_pool, M, N, A, B, TRANS_STEAL);
+    else
+        transpose_simd(M, N, A, B);
+}
@@ -0,0 +1,49 @@
+/*
+ * trans-par.h - Prototypes for the multi-threaded blocked transpose
+ */
+
+#ifndef CACHELAB_TRANS_PAR_H
+#define CACHELAB_TRANS_PAR_H
+
+/* How the tile rows of B are handed to the workers */
+#define TRANS_STATIC 0   /* one fixed contiguous share per worker */
+#define TRANS_STEAL  1   /* the same shares, with idle workers stealing */
+
+/* Most workers a pool can have */
+#define TRANS_MAX_THREADS 256
+
+/* A pool of workers; the layout is private to trans-par.c */
+typedef struct trans_pool trans_pool_t;
+
+/*
+ * trans_pool_new - Start a pool of nthreads worker threads; the caller
+ *     only waits while they run. With pin set, worker i is bound to the
+ *     i-th CPU the process may run on, so the pages it first touches
+ *     stay local. Returns NULL if the threads cannot be started.
+ */
+trans_pool_t *trans_pool_new(int nthreads, int pin);
+
+/* Stop the workers and release the pool */
+void trans_pool_free(trans_pool_t *p);
+
+/*
+ * trans_pool_touch - Zero the M x N destination B with each worker
+ *     writing the rows that TRANS_STATIC gives it, so that on a NUMA
+ *     machine every page of B is placed on the node of its writer. Call
+ *     it on freshly mapped memory, before anything else writes B.
+ */
+void trans_pool_touch(trans_pool_t *p, int M, int N, int *B);
+
+/* trans_pool_run - Transpose A into B on the pool */
+void trans_pool_run(trans_pool_t *p, int M, int N, int A[N][M], int B[M][N],
+                    int sched);
+
+/*
+ * transpose_parallel - The transpose signature for the driver: runs on
+ *     a pool of one pinned worker per online CPU, started on first use,
+ *     with work stealing
+ */
+extern char transpose_parallel_desc[];
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N]);
+
+#endif /* CACHELAB_TRANS_PAR_H */
@@ -0,0 +1,223 @@
+/*
+ * trans-simd.c - Transposes for wall clock speed rather than simulated
+ *     misses
+ *
+ * A micro kernel loads a KxK tile of A as K rows of one vector each,
+ * transposes it with unpack and lane shuffles without leaving the
+ * registers, and stores the K rows of the B tile: 4x4 with SSE2, 8x8
+ * with AVX2, and 8x8 one element at a time for comparison. The driver
+ * walks BLOCK x BLOCK blocks so the B lines a block writes are still
+ * cached while the block's rows of A stream past, runs the kernel over
+ * the full tiles of each block, and moves the ragged right and bottom
+ * edges one element at a time. It is inlined into each kernel's entry
+ * point, which carries the kernel's target attribute, so the kernel
+ * call compiles to straight line vector code.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "trans-simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANS_X86 1
+#endif
+
+/* Side of the cache blocks, in ints; a multiple of every kernel's K */
+#define BLOCK 64
+
+/*
+ * blocked - Transpose columns j0..j1-1 of A into rows j0..j1-1 of B,
+ *     with kernel doing each full k x k tile whose top left corner is
+ *     A[i][j]
+ */
+static inline __attribute__((always_inline))
+void blocked(int M, int N, int A[N][M], int B[M][N], int j0, int j1, int k,
+             void (*kernel)(int M, int N, int A[N][M], int B[M][N], int i, int j))
+{
+    int ii, jj, i, j, fullN = N - N % k, fullM = j1 - (j1 - j0) % k;
+
+    for (ii = 0; ii < fullN; ii += BLOCK)
+        for (jj = j0; jj < fullM; jj += BLOCK)
+            for (i = ii; i < ii + BLOCK && i < fullN; i += k)
+                for (j = jj; j < jj + BLOCK && j < fullM; j += k)
+                    kernel(M, N, A, B, i, j);
+
+    /* The columns right of the last full tile, then the rows below */
+    for (i = 0; i < fullN; i++)
+        for (j = fullM; j < j1; j++)
+            B[j][i] = A[i][j];
+    for (i = fullN; i < N; i++)
+        for (j = j0; j < j1; j++)
+            B[j][i] = A[i][j];
+}
+
+static inline __attribute__((always_inline))
+void kernel_scalar8(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    int r, c;
+
+    for (r = 0; r < 8; r++)
+        for (c = 0; c < 8; c++)
+            B[j + c][i + r] = A[i + r][j + c];
+}
+
+static void scalar8(int M, int N, int A[N][M], int B[M][N], int j0, int j1)
+{
+    blocked(M, N, A, B, j0, j1, 8, kernel_scalar8);
+}
+
+char transpose_scalar8_desc[] = "Blocked transpose, scalar 8x8 tiles";
+void transpose_scalar8(int M, int N, int A[N][M], int B[M][N])
+{
+    scalar8(M, N, A, B, 0, M);
+}
+
+#ifdef TRANS_X86
+static inline __attribute__((always_inline))
+void kernel_sse4x4(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)&A[i][j]);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)&A[i + 1][j]);
+    __m128i r2 = _mm_loadu_si128((const __m128i *)&A[i + 2][j]);
+    __m128i r3 = _mm_loadu_si128((const __m128i *)&A[i + 3][j]);
+    /* a0 b0 a1 b1, c0 d0 c1 d1, a2 b2 a3 b3, c2 d2 c3 d3 */
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)&B[j][i], _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)&B[j + 1][i], _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)&B[j + 2][i], _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *)&B[j + 3][i], _mm_unpackhi_epi64(t2, t3));
+}
+
+#define LOAD8(r) _mm256_loadu_si256((const __m256i *)&A[i + (r)][j])
+#define STORE8(c, v) _mm256_storeu_si256((__m256i *)&B[j + (c)][i], v)
+
+/* Written out in full: loops over arrays of vectors end up on the stack */
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline))
+void kernel_avx8x8(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    __m256i r0 = LOAD8(0), r1 = LOAD8(1), r2 = LOAD8(2), r3 = LOAD8(3);
+    __m256i r4 = LOAD8(4), r5 = LOAD8(5), r6 = LOAD8(6), r7 = LOAD8(7);
+    /* Pairs of rows interleaved: a0 b0 a1 b1 | a4 b4 a5 b5, ... */
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1), t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3), t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5), t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7), t7 = _mm256_unpackhi_epi32(r6, r7);
+    /* Quads: a0 b0 c0 d0 | a4 b4 c4 d4, a1 .. d1 | a5 .. d5, ... */
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    /* Low lanes of rows a-d and e-h make columns 0-3, high lanes 4-7 */
+    STORE8(0, _mm256_permute2x128_si256(u0, u4, 0x20));
+    STORE8(1, _mm256_permute2x128_si256(u1, u5, 0x20));
+    STORE8(2, _mm256_permute2x128_si256(u2, u6, 0x20));
+    STORE8(3, _mm256_permute2x128_si256(u3, u7, 0x20));
+    STORE8(4, _mm256_permute2x128_si256(u0, u4, 0x31));
+    STORE8(5, _mm256_permute2x128_si256(u1, u5, 0x31));
+    STORE8(6, _mm256_permute2x128_si256(u2, u6, 0x31));
+    STORE8(7, _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+static void sse4x4(int M, int N, int A[N][M], int B[M][N], int j0, int j1)
+{
+    blocked(M, N, A, B, j0, j1, 4, kernel_sse4x4);
+}
+
+__attribute__((target("avx2")))
+static void avx8x8(int M, int N, int A[N][M], int B[M][N], int j0, int j1)
+{
+    blocked(M, N, A, B, j0, j1, 8, kernel_avx8x8);
+}
+#endif /* TRANS_X86 */
+
+/*
+ * Widest kernel: 0 scalar, 1 SSE2, 2 AVX2. The trans-par pool workers
+ * all reach transpose_simd_cols at once, so it is chosen under
+ * pthread_once.
+ */
+static int simd_level;
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+/*
+ * pick_simd - Choose the kernel from TRANS_SIMD or the CPU
+ */
+static void pick_simd(void)
+{
+    const char *env = getenv("TRANS_SIMD");
+
+    simd_level = 0;
+#ifdef TRANS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        simd_level = 2;
+    else if (__builtin_cpu_supports("sse2"))
+        simd_level = 1;
+    if (env && strcmp(env, "scalar") == 0)
+        simd_level = 0;
+    else if (env && strcmp(env, "sse2") == 0 && simd_level >= 1)
+        simd_level = 1;
+#else
+    (void)env;
+#endif
+}
+
+const char *trans_simd_name(void)
+{
+    static const char *names[] = {"scalar", "sse2", "avx2"};
+
+    pthread_once(&simd_once, pick_simd);
+    return names[simd_level];
+}
+
+char transpose_sse4x4_desc[] = "Blocked transpose, SSE2 4x4 tiles";
+void transpose_sse4x4(int M, int N, int A[N][M], int B[M][N])
+{
+#ifdef TRANS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        sse4x4(M, N, A, B, 0, M);
+        return;
+    }
+#endif
+    transpose_scalar8(M, N, A, B);
+}
+
+char transpose_avx8x8_desc[] = "Blocked transpose, AVX2 8x8 tiles";
+void transpose_avx8x8(int M, int N, int A[N][M], int B[M][N])
+{
+#ifdef TRANS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        avx8x8(M, N, A, B, 0, M);
+        return;
+    }
+#endif
+    transpose_sse4x4(M, N, A, B);
+}
+
+void transpose_simd_cols(int M, int N, int A[N][M], int B[M][N],
+                         int j0, int j1)
+{
+    pthread_once(&simd_once, pick_simd);
+#ifdef TRANS_X86
+    if (simd_level == 2)
+        avx8x8(M, N, A, B, j0, j1);
+    else if (simd_level == 1)
+        sse4x4(M, N, A, B, j0, j1);
+    else
+#endif
+        scalar8(M, N, A, B, j0, j1);
+}
+
+char transpose_simd_desc[] = "Blocked transpose, widest SIMD tiles";
+void transpose_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_simd_cols(M, N, A, B, 0, M);
+}
@@ -0,0 +1,41 @@
+/*
+ * trans-simd.h - Prototypes for the native speed transposes built from
+ *     SSE2 and AVX2 in-register tile kernels
+ */
+
+#ifndef CACHELAB_TRANS_SIMD_H
+#define CACHELAB_TRANS_SIMD_H
+
+/*
+ * All of them take the usual transpose arguments, so they can be handed
+ * to registerTransFunction as they are. The SSE2 and AVX2 versions fall
+ * back to the next narrower one when the CPU lacks the instructions.
+ */
+extern char transpose_scalar8_desc[];
+void transpose_scalar8(int M, int N, int A[N][M], int B[M][N]);
+
+extern char transpose_sse4x4_desc[];
+void transpose_sse4x4(int M, int N, int A[N][M], int B[M][N]);
+
+extern char transpose_avx8x8_desc[];
+void transpose_avx8x8(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * transpose_simd - The widest of the above the CPU supports, or the one
+ *     named by the TRANS_SIMD environment variable ("avx2", "sse2" or
+ *     "scalar")
+ */
+extern char transpose_simd_desc[];
+void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * transpose_simd_cols - transpose_simd restricted to columns j0..j1-1 of
+ *     A, which become rows j0..j1-1 of B
+ */
+void transpose_simd_cols(int M, int N, int A[N][M], int B[M][N],
+                         int j0, int j1);
+
+/* Name of the kernel transpose_simd uses */
+const char *trans_simd_name(void);
+
+#endif /* CACHELAB_TRANS_SIMD_H */
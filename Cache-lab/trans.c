@@ -167,7 +167,7 @@ void transpose_1393(int M, int N, int A[N][M], int B[M][N])
 	//32 bytes per set ==> 8 int per set
 	REQUIRES(M > 0);
 	REQUIRES(N > 0);
-	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4,tmp5,tmp6,tmp7,tmp;
+	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4=0,tmp5=0,tmp6=0,tmp7=0,tmp;
 	if(M==32) {
 	//0x80 bytes per row
 	// 1 set for A
@@ -347,7 +347,7 @@ void transpose_1403(int M, int N, int A[N][M], int B[M][N])
 	//32 bytes per set ==> 8 int per set
 	REQUIRES(M > 0);
 	REQUIRES(N > 0);
-	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4,tmp5,tmp6,tmp7,tmp;
+	int i,j,i1,tmp0=0,tmp1=0,tmp2=0,tmp3=0,tmp4=0,tmp5=0,tmp6=0,tmp7=0,tmp;
 	if(M==32) {
 	//0x80 bytes per row
 	// 1 set for A
@@ -512,7 +512,7 @@ void transpose_1411_1(int M, int N, int A[N][M], int B[M][N]){
 	//32 bytes per set ==> 8 int per set
 	REQUIRES(M > 0);
 	REQUIRES(N > 0);
-	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4,tmp5,tmp6,tmp7;
+	int i,j,i1,tmp0=0,tmp1=0,tmp2=0,tmp3=0,tmp4=0,tmp5=0,tmp6=0,tmp7=0;
 	if(M==32) {
 	//0x80 bytes per row
 	// 1 set for A
@@ -642,7 +642,7 @@ void transpose_1411_2(int M, int N, int A[N][M], int B[M][N])
 	//32 bytes per set ==> 8 int per set
 	REQUIRES(M > 0);
 	REQUIRES(N > 0);
-	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4,tmp5,tmp6,tmp7;
+	int i,j,i1,tmp0,tmp1,tmp2,tmp3,tmp4=0,tmp5=0,tmp6=0,tmp7=0;
 	if(M==32) {
 	//0x80 bytes per row
 	// 1 set for A
@@ -760,6 +760,76 @@ void transpose_1411_2(int M, int N, int A[N][M], int B[M][N])
 	}
 	ENSURES(is_transpose(M, N, A, B));
 }
+/*
+ * transpose_oblivious - Cache-oblivious transpose for any M and N. The
+ *     block of A being transposed is halved across its longer side,
+ *     counted in tiles, at a tile boundary until it is a single tile of
+ *     at most TILE_R rows by TILE_C columns. Each row of a tile goes
+ *     through registers, so a diagonal tile does not make A and B evict
+ *     each other. Every level of the recursion is cache friendly for
+ *     some cache size, so it needs no tuning for the shape or the cache.
+ *     TILE_C is half a 32 byte block: B's rows of one tile then stay
+ *     clear of each other even when a row of B is a multiple of the
+ *     cache size, as for 64x64. The recursion breaks the handout's
+ *     rules for graded code, so this is registered as an extra function.
+ */
+#define TILE_R 8
+#define TILE_C 4
+
+/* split - The multiple of t nearest the middle of [lo, hi), for hi - lo > t */
+static int split(int lo, int hi, int t)
+{
+	return (lo + (hi - lo) / 2 + t / 2) / t * t;
+}
+
+/* trans_rec - Transpose rows r0..r1-1 and columns c0..c1-1 of A into B */
+static void trans_rec(int M, int N, int A[N][M], int B[M][N],
+		      int r0, int r1, int c0, int c1)
+{
+	int i, j, tmp0, tmp1, tmp2, tmp3;
+
+	if (r1 - r0 > TILE_R || c1 - c0 > TILE_C) {
+		if ((r1 - r0) * TILE_C >= (c1 - c0) * TILE_R) {
+			i = split(r0, r1, TILE_R);
+			trans_rec(M, N, A, B, r0, i, c0, c1);
+			trans_rec(M, N, A, B, i, r1, c0, c1);
+		}
+		else {
+			j = split(c0, c1, TILE_C);
+			trans_rec(M, N, A, B, r0, r1, c0, j);
+			trans_rec(M, N, A, B, r0, r1, j, c1);
+		}
+		return;
+	}
+	for (i = r0; i < r1; i++) {
+		if (c1 - c0 == TILE_C) {
+			tmp0 = A[i][c0];
+			tmp1 = A[i][c0+1];
+			tmp2 = A[i][c0+2];
+			tmp3 = A[i][c0+3];
+			B[c0][i] = tmp0;
+			B[c0+1][i] = tmp1;
+			B[c0+2][i] = tmp2;
+			B[c0+3][i] = tmp3;
+		}
+		else {
+			for (j = c0; j < c1; j++)
+				B[j][i] = A[i][j];
+		}
+	}
+}
+
+char transpose_oblivious_desc[] = "Cache-oblivious recursive transpose";
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N])
+{
+	REQUIRES(M > 0);
+	REQUIRES(N > 0);
+
+	trans_rec(M, N, A, B, 0, N, 0, M);
+
+	ENSURES(is_transpose(M, N, A, B));
+}
+
 /* 
  * trans - A simple baseline transpose function, not optimized for the cache.
  */
@@ -796,6 +866,7 @@ void registerFunctions()
 	//registerTransFunction(transpose_test1, transpose_test1_desc); 
 	/* Register any additional transpose functions */
 	registerTransFunction(trans, trans_desc); 
+	registerTransFunction(transpose_oblivious, transpose_oblivious_desc); 
 
 }
 
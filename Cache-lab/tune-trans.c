@@ -0,0 +1,275 @@
+/*
+ * tune-trans.c - Search the tile shape and diagonal handling of the
+ *     blocked transpose in tiled.c for each matrix size, and emit the
+ *     best kernel found for each one
+ *
+ * Every candidate is traced as test-trans -i traces a function: a
+ * tracegen run validates it, and a second one pipes its trace into
+ * csim under the target s, E and b. The candidates run as parallel
+ * jobs, each in a scratch directory of its own, since tracegen and csim
+ * talk through the .marker and .csim_results files of the working
+ * directory. Progress goes to stderr and the generated code to stdout
+ * or the -o file.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "tiled.h"
+
+/* Maximum array dimension, as in test-trans */
+#define MAXN 256
+#define MAX_SIZES 16
+#define DEFAULT_SIZES "32x32,64x64,61x67"
+
+/* The tile heights and widths searched */
+static const int heights[] = {4, 8, 16, 32};
+static const int widths[] = {4, 8, 16};
+#define NHEIGHTS (int)(sizeof(heights) / sizeof(heights[0]))
+#define NWIDTHS (int)(sizeof(widths) / sizeof(widths[0]))
+
+/* One candidate tiling of one matrix size */
+typedef struct {
+    int M, N;
+    tiling_t t;
+    pid_t pid;
+    char dir[32];
+    long misses;                /* -1 if it failed or was not run */
+} job_t;
+
+static char bindir[PATH_MAX];
+static unsigned int s = 5, E = 1, b = 5;
+
+static void spec(const tiling_t *t, char *buf, size_t n)
+{
+    snprintf(buf, n, "%dx%d:%s", t->h, t->w, tiling_diag_name(t->diag));
+}
+
+/*
+ * start - Fork the shell pipeline for job j in a fresh scratch directory
+ */
+static void start(job_t *j)
+{
+    char cmd[3 * PATH_MAX + 512], t[64];
+
+    spec(&j->t, t, sizeof(t));
+    strcpy(j->dir, "/tmp/tune-trans.XXXXXX");
+    if (mkdtemp(j->dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    snprintf(cmd, sizeof(cmd),
+             "%s/tracegen -M %d -N %d -T %s > /dev/null && "
+             "%s/tracegen -M %d -N %d -T %s -t - | "
+             "%s/csim -s %u -E %u -b %u -m .marker -t - > /dev/null",
+             bindir, j->M, j->N, t, bindir, j->M, j->N, t, bindir, s, E, b);
+    if ((j->pid = fork()) < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (j->pid == 0) {
+        if (chdir(j->dir) < 0)
+            _exit(127);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+}
+
+/*
+ * finish - Collect the misses of a finished job and remove its scratch
+ *     directory
+ */
+static void finish(job_t *j)
+{
+    char path[64], t[64];
+    unsigned int hits, misses, evictions;
+    FILE *fp;
+
+    j->misses = -1;
+    snprintf(path, sizeof(path), "%s/.csim_results", j->dir);
+    if ((fp = fopen(path, "r")) != NULL) {
+        if (fscanf(fp, "%u %u %u", &hits, &misses, &evictions) == 3)
+            j->misses = misses;
+        fclose(fp);
+    }
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/.marker", j->dir);
+    unlink(path);
+    rmdir(j->dir);
+
+    spec(&j->t, t, sizeof(t));
+    if (j->misses < 0)
+        fprintf(stderr, "%3dx%-3d %-12s failed\n", j->M, j->N, t);
+    else
+        fprintf(stderr, "%3dx%-3d %-12s misses:%ld\n", j->M, j->N, t, j->misses);
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-d <MxN>[,...]] [-s <s>] [-E <E>] [-b <b>] "
+           "[-j <jobs>] [-o <file>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -d <list>   Matrix sizes to tune, as for test-trans -M and -N "
+           "(default %s).\n", DEFAULT_SIZES);
+    printf("  -s, -E, -b  Cache to tune for (default s=5, E=1, b=5).\n");
+    printf("  -j <jobs>   Candidates evaluated at once (default: online CPUs).\n");
+    printf("  -o <file>   Write the generated kernels to file, not stdout.\n");
+    printf("Example: %s -d 64x64 -j 8 -o tuned.c\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    char *sizes = DEFAULT_SIZES, *out = NULL, t[64];
+    int M[MAX_SIZES], N[MAX_SIZES], nsizes = 0, njobs, next, running;
+    int c, i, k, len, jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    job_t *job, *best[MAX_SIZES];
+    pid_t pid;
+    FILE *fp = stdout;
+
+    while ((c = getopt(argc, argv, "d:s:E:b:j:o:h")) != -1) {
+        switch (c) {
+        case 'd':
+            sizes = optarg;
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    while (nsizes < MAX_SIZES &&
+           sscanf(sizes, "%dx%d%n", &M[nsizes], &N[nsizes], &len) == 2) {
+        if (M[nsizes] < 1 || N[nsizes] < 1 || M[nsizes] > MAXN || N[nsizes] > MAXN) {
+            printf("Error: sizes must be between 1 and %d\n", MAXN);
+            exit(1);
+        }
+        /* Each size becomes one transpose_tuned_MxN definition */
+        for (k = 0; k < nsizes; k++)
+            if (M[k] == M[nsizes] && N[k] == N[nsizes]) {
+                printf("Error: size %dx%d given twice\n", M[k], N[k]);
+                exit(1);
+            }
+        nsizes++;
+        sizes += len;
+        if (*sizes != ',')
+            break;
+        sizes++;
+    }
+    if (nsizes == 0 || *sizes != '\0' || E < 1 || jobs < 1) {
+        usage(argv);
+        exit(1);
+    }
+    if (getcwd(bindir, sizeof(bindir)) == NULL) {
+        perror("getcwd");
+        exit(1);
+    }
+
+    /* Every size gets every tiling; DIAG_ROW only for tiles it can buffer */
+    job = calloc((size_t)nsizes * NHEIGHTS * NWIDTHS * NUM_DIAG, sizeof(job_t));
+    if (job == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    njobs = 0;
+    for (i = 0; i < nsizes; i++)
+        for (c = 0; c < NHEIGHTS * NWIDTHS * NUM_DIAG; c++) {
+            job[njobs].M = M[i];
+            job[njobs].N = N[i];
+            job[njobs].t.h = heights[c / (NWIDTHS * NUM_DIAG)];
+            job[njobs].t.w = widths[c / NUM_DIAG % NWIDTHS];
+            job[njobs].t.diag = c % NUM_DIAG;
+            if (job[njobs].t.diag != DIAG_ROW || job[njobs].t.w <= TILED_MAX_W)
+                njobs++;
+        }
+
+    fprintf(stderr, "%d candidates for s=%u, E=%u, b=%u, %d at a time\n",
+            njobs, s, E, b, jobs);
+    for (next = running = 0; next < njobs || running > 0;) {
+        while (running < jobs && next < njobs) {
+            start(&job[next++]);
+            running++;
+        }
+        if ((pid = wait(NULL)) < 0) {
+            perror("wait");
+            exit(1);
+        }
+        for (k = 0; k < next; k++)
+            if (job[k].pid == pid) {
+                job[k].pid = 0;
+                finish(&job[k]);
+                running--;
+            }
+    }
+
+    /* Keep the first of the candidates with the fewest misses */
+    for (i = 0; i < nsizes; i++) {
+        best[i] = NULL;
+        for (k = 0; k < njobs; k++)
+            if (job[k].M == M[i] && job[k].N == N[i] && job[k].misses >= 0 &&
+                (best[i] == NULL || job[k].misses < best[i]->misses))
+                best[i] = &job[k];
+        if (best[i] == NULL) {
+            fprintf(stderr, "Error: every candidate for %dx%d failed\n", M[i], N[i]);
+            exit(1);
+        }
+    }
+
+    if (out && (fp = fopen(out, "w")) == NULL) {
+        perror(out);
+        exit(1);
+    }
+    fprintf(fp, "/*\n * Generated by tune-trans for s=%u, E=%u, b=%u. Register\n"
+            " * transpose_tuned with registerTransFunction to use it.\n */\n",
+            s, E, b);
+    for (i = 0; i < nsizes; i++) {
+        spec(&best[i]->t, t, sizeof(t));
+        fprintf(stderr, "best for %dx%d: %s, %ld misses\n", M[i], N[i], t,
+                best[i]->misses);
+        fprintf(fp, "\n/* %dx%d: %s tiling, %ld misses */\n", M[i], N[i], t,
+                best[i]->misses);
+        snprintf(t, sizeof(t), "transpose_tuned_%dx%d", M[i], N[i]);
+        tiling_emit(fp, t, M[i], N[i], &best[i]->t);
+    }
+    fprintf(fp, "\nchar transpose_tuned_desc[] = \"Tuned blocked transpose\";\n"
+            "void transpose_tuned(int M, int N, int A[N][M], int B[M][N])\n{\n"
+            "\tint i, j;\n\n");
+    for (i = 0; i < nsizes; i++)
+        fprintf(fp, "\t%sif (M == %d && N == %d)\n"
+                "\t\ttranspose_tuned_%dx%d(M, N, A, B);\n",
+                i ? "else " : "", M[i], N[i], M[i], N[i]);
+    fprintf(fp, "\telse {\n"
+            "\t\tfor (i = 0; i < N; i++)\n"
+            "\t\t\tfor (j = 0; j < M; j++)\n"
+            "\t\t\t\tB[j][i] = A[i][j];\n"
+            "\t}\n}\n");
+    if (out)
+        fclose(fp);
+    free(job);
+    return 0;
+}
@@ -18,6 +18,9 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
 
 
 #include "mm.h"
@@ -189,6 +192,12 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
 static void eval_mm_speed(void *ptr);
 
+#ifdef MM_THREADS
+/* Replays the traces on several threads at once (-T) */
+static int run_threads(int num_tracefiles, const char *tracedir,
+                       char **tracefiles, int maxthreads);
+#endif
+
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
 static void usage(void);
@@ -278,6 +287,7 @@ int main(int argc, char **argv)
     int run_libc = 0;     /* If set, run libc malloc (set by -l) */
     int autograder = 0;   /* if set then called by autograder (-A) */
     int checkpoint = 0;
+    int threads = 0;      /* If set, replay on up to this many threads (-T) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput = 0, p1, p2, perfindex;
@@ -291,7 +301,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hpVAlD")) != EOF) {
+    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hpVAlDT:")) != EOF) {
         switch (c) {
 
         case 'A': /* Hidden Autolab driver argument */
@@ -352,6 +362,10 @@ int main(int argc, char **argv)
             set_timeout = atoi(optarg);
             break;
 
+        case 'T': /* Replay the traces concurrently */
+            threads = atoi(optarg);
+            break;
+
         case 'h': /* Print this message */
             usage();
             exit(0);
@@ -368,6 +382,14 @@ int main(int argc, char **argv)
         printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    if (threads > 0) {
+#ifdef MM_THREADS
+        exit(run_threads(num_tracefiles, tracedir, tracefiles, threads));
+#else
+        app_error("-T needs the thread-safe build; run mdriver-mt\n");
+#endif
+    }
+
     if(debug_mode != DBG_NONE) {
         init_random_data();
     }
@@ -1155,6 +1177,247 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+#ifdef MM_THREADS
+/*****************************************************************
+ * Threaded replay (-T). Each thread replays its share of the traces
+ * MT_REPS times over against the one shared heap, and the throughput is
+ * the requests of all the threads over the wall clock time. Only the
+ * traces the throughput score counts are replayed; the others test
+ * corner cases, such as a 50MB block, that a heap shared by several
+ * traces at once has no room for. The traces were recorded single
+ * threaded, so to have blocks freed by a thread other than the one that
+ * allocated them, every HANDOFF_EVERY-th free swaps its block into a
+ * shared slot and frees the block that was there instead. The first and
+ * last byte of every payload hold the tag of its thread and are checked
+ * when it is freed, a cheap test that no two threads were handed the
+ * same bytes.
+ ****************************************************************/
+#define MT_REPS       20
+#define HANDOFF_SLOTS 64
+#define HANDOFF_EVERY 8
+
+typedef struct {
+    trace_t **traces;  /* the traces this thread replays in turn */
+    int num_traces;
+    char tag;          /* written to the ends of its payloads */
+    int errors;        /* requests that failed or tags found garbled */
+} mt_thread_t;
+
+static pthread_mutex_t handoff_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *handoff_slots[HANDOFF_SLOTS];
+static unsigned int handoff_next;
+
+/*
+ * handoff - Leave block p in the next slot and take the one that was
+ *     there, most likely from another thread
+ */
+static char *handoff(char *p)
+{
+    char *q;
+
+    pthread_mutex_lock(&handoff_lock);
+    q = handoff_slots[handoff_next++ % HANDOFF_SLOTS];
+    handoff_slots[(handoff_next - 1) % HANDOFF_SLOTS] = p;
+    pthread_mutex_unlock(&handoff_lock);
+    return q;
+}
+
+/*
+ * mt_tagged - Return 1 if the payload p of size bytes carries tag
+ */
+static int mt_tagged(const char *p, size_t size, char tag)
+{
+    return p[0] == tag && p[size - 1] == tag;
+}
+
+/*
+ * mt_replay - Run every request of trace once, then free whatever the
+ *     trace left allocated
+ */
+static void mt_replay(mt_thread_t *t, trace_t *trace)
+{
+    int i, index;
+    size_t size;
+    char *p;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+
+        case ALLOC:
+        case REALLOC:
+            p = trace->blocks[index];
+            if (p != NULL &&
+                !mt_tagged(p, trace->block_sizes[index], t->tag))
+                t->errors++;
+            if (trace->ops[i].type == ALLOC)
+                p = mm_malloc(size);
+            else if (p == NULL)
+                p = mm_realloc(NULL, size);
+            else if ((p = mm_realloc(p, size)) != NULL && p[0] != t->tag)
+                t->errors++;
+            trace->blocks[index] = p;
+            if (p == NULL) {
+                if (size != 0)
+                    t->errors++;
+                break;
+            }
+            if (!IS_ALIGNED(p))
+                t->errors++;
+            p[0] = p[size - 1] = t->tag;
+            trace->block_sizes[index] = size;
+            break;
+
+        case FREE:
+            if (index < 0) {
+                mm_free(NULL);
+                break;
+            }
+            if ((p = trace->blocks[index]) == NULL)
+                break;  /* its allocation failed */
+            trace->blocks[index] = NULL;
+            if (!mt_tagged(p, trace->block_sizes[index], t->tag))
+                t->errors++;
+            if (i % HANDOFF_EVERY == 0)
+                p = handoff(p);
+            mm_free(p);
+            break;
+        }
+    }
+
+    for (index = 0; index < trace->num_ids; index++)
+        if (trace->blocks[index] != NULL) {
+            mm_free(trace->blocks[index]);
+            trace->blocks[index] = NULL;
+        }
+}
+
+static void *mt_thread(void *arg)
+{
+    mt_thread_t *t = arg;
+    int rep, i;
+
+    for (rep = 0; rep < MT_REPS; rep++)
+        for (i = 0; i < t->num_traces; i++)
+            mt_replay(t, t->traces[i]);
+    return NULL;
+}
+
+/*
+ * mt_run - Replay the traces on nthreads threads against a fresh heap.
+ *     Returns the number of errors and sets *ops and *secs.
+ */
+static int mt_run(int num_tracefiles, const char *tracedir,
+                  char **tracefiles, int nthreads, double *ops, double *secs)
+{
+    int total = num_tracefiles > nthreads ? num_tracefiles : nthreads;
+    mt_thread_t *threads;
+    pthread_t *tids;
+    stats_t stats;
+    struct timespec start, end;
+    trace_t *trace;
+    int i, errs = 0;
+
+    threads = calloc(nthreads, sizeof(*threads));
+    tids = calloc(nthreads, sizeof(*tids));
+    if (threads == NULL || tids == NULL)
+        unix_error("calloc failed in mt_run");
+
+    /* Thread i gets traces i, i + nthreads, ..., each a private copy */
+    *ops = 0;
+    for (i = 0; i < nthreads; i++) {
+        threads[i].tag = 'a' + i % 26;
+        threads[i].traces = calloc((total + nthreads - 1) / nthreads,
+                                   sizeof(trace_t *));
+        if (threads[i].traces == NULL)
+            unix_error("calloc failed in mt_run");
+    }
+    for (i = 0; i < total; i++) {
+        trace = read_trace(&stats, tracedir, tracefiles[i % num_tracefiles]);
+        threads[i % nthreads].traces[threads[i % nthreads].num_traces++] = trace;
+        *ops += (double)MT_REPS * trace->num_ops;
+    }
+
+    mem_init();
+    if (mm_init() < 0)
+        app_error("mm_init failed in mt_run");
+    memset(handoff_slots, 0, sizeof(handoff_slots));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nthreads; i++)
+        if ((errno = pthread_create(&tids[i], NULL, mt_thread, &threads[i])))
+            unix_error("pthread_create failed in mt_run");
+    for (i = 0; i < nthreads; i++)
+        pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    for (i = 0; i < HANDOFF_SLOTS; i++)
+        mm_free(handoff_slots[i]);
+    mm_checkheap(__LINE__);
+    mem_deinit();
+
+    for (i = 0; i < nthreads; i++) {
+        errs += threads[i].errors;
+        while (threads[i].num_traces > 0)
+            free_trace(threads[i].traces[--threads[i].num_traces]);
+        free(threads[i].traces);
+    }
+    free(threads);
+    free(tids);
+    return errs;
+}
+
+/*
+ * run_threads - Print the aggregate throughput of 1, 2, 4, ... up to
+ *     maxthreads threads replaying the traces. Returns 1 on errors.
+ */
+static int run_threads(int num_tracefiles, const char *tracedir,
+                       char **tracefiles, int maxthreads)
+{
+    double ops, secs, base = 0;
+    int i, n, errs, num_timed = 0;
+    char **timed;
+    stats_t stats;
+    trace_t *trace;
+
+    if ((timed = calloc(num_tracefiles, sizeof(char *))) == NULL)
+        unix_error("calloc failed in run_threads");
+    for (i = 0; i < num_tracefiles; i++) {
+        trace = read_trace(&stats, tracedir, tracefiles[i]);
+        if (trace->weight == WALL || trace->weight == WPERF)
+            timed[num_timed++] = tracefiles[i];
+        free_trace(trace);
+    }
+    if (num_timed == 0)
+        app_error("None of the traces counts for throughput\n");
+    num_tracefiles = num_timed;
+    tracefiles = timed;
+
+    printf("Replaying %d traces %d times on 1 to %d threads\n",
+           num_tracefiles, MT_REPS, maxthreads);
+    printf("%7s %12s %10s %10s %8s\n", "threads", "ops", "secs", "Kops",
+           "scaling");
+    for (n = 1;; n = 2 * n < maxthreads ? 2 * n : maxthreads) {
+        errs = mt_run(num_tracefiles, tracedir, tracefiles, n, &ops, &secs);
+        if (errs > 0) {
+            printf("%7d terminated with %d errors\n", n, errs);
+            free(timed);
+            return 1;
+        }
+        if (n == 1)
+            base = ops / secs;
+        printf("%7d %12.0f %10.6f %10.0f %7.2fx\n", n, ops, secs,
+               ops / secs / 1e3, ops / secs / base);
+        if (n == maxthreads)
+            break;
+    }
+    free(timed);
+    return 0;
+}
+#endif /* def MM_THREADS */
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1441,4 +1704,6 @@ static void usage(void)
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-T <n>     Replay the traces concurrently on 1 to n threads\n"
+                    "\t           and report the aggregate throughput (mdriver-mt).\n");
 }
@@ -3,15 +3,22 @@
  *
  * Name : Milozms
  * Segregate list allocator
+ *
+ * Built with -DMM_THREADS the allocator may be called from several
+ * threads at once; see the thread-safe mode section at the end.
  */
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /* If you want debugging output, use the following macro.  When you hand
  * in, remove the #define DEBUG line. */
@@ -55,7 +62,9 @@
 #define GET_SIZE(p)  (GET(p) & ~0x7)                   
 #define GET_ALLOC(p) (GET(p) & 0x1)                    
 
-/* Given block ptr bp, compute address of its header and footer */
+/* Given block ptr bp, compute address of its header and footer;
+   only free blocks have a footer, the prev-alloc bit stands in for
+   it on allocated ones */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)                      
 #define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE) 
 /* Given block ptr bp, compute address of next and previous blocks */
@@ -69,131 +78,294 @@
 #define GET_PREV_ALLOC(bp) ((GET(HDRP(bp)) & 0x2)>>1)
 #define SET_PREV_ALLOC(bp, alloc) PUT(HDRP(bp), GET(HDRP(bp)) | (alloc<<1)) 
 
+/*
+ * Compressed pointers. Every pointer the heap stores, in free blocks,
+ * list heads, slabs and tcaches alike, is an offset_t: 32 bits counted
+ * from start_of_heap, which covers heaps of up to 4 GiB whatever their
+ * address. Offset 0 is the start of the prelude, which no block or list
+ * head can be, so it serves as NULL. ADR_CAST compresses a pointer into
+ * the heap and ADR_RECV expands an offset back; nothing else may
+ * convert between the two.
+ */
+typedef unsigned int offset_t;
+#define HEAP_SHIFT  27      /* MAX_HEAP <= 2^HEAP_SHIFT <= 2^32 */
+#if HEAP_SHIFT > 32
+#error "offset_t cannot address a heap above 4 GiB"
+#endif
+_Static_assert(MAX_HEAP <= (1UL << HEAP_SHIFT),
+               "HEAP_SHIFT must cover the MAX_HEAP bytes memlib can hand out");
+#define ADR_CAST(bp)   ((offset_t)((char *)(bp) - start_of_heap))
+#define ADR_RECV(off)  (start_of_heap + (offset_t)(off))
+
  /* Given block ptr bp, 
  compute address of prev/next ptr (to prev/next FREE block) */
 #define PREV_PTR(bp)  (char *)(bp + WSIZE)
 #define NEXT_PTR(bp)  (char *)(bp)
  /* Given block ptr bp, compute address of prev/next free block */
-#define PREV_FREE(bp)  (char *)(GET(PREV_PTR(bp)) + start_of_heap)
-#define NEXT_FREE(bp)  (char *)(GET(NEXT_PTR(bp)) + start_of_heap)
-#define ADR_CAST(bp)   ((unsigned int)bp - (unsigned int)start_of_heap)
-#define ADR_RECV(bp)   (char *)(bp + start_of_heap)
+#define PREV_FREE(bp)  ADR_RECV(GET(PREV_PTR(bp)))
+#define NEXT_FREE(bp)  ADR_RECV(GET(NEXT_PTR(bp)))
+
+/*
+ * Two-level segregated fit. A free block of size bytes lives in list
+ * (fl, sl): below SMALL_SIZE fl is 0 and sl counts 8 byte steps, up to
+ * 2^(FL_SHIFT+1) fl picks the power of two the size falls in and sl one
+ * of SL_COUNT equal slices of that range, and any bigger block goes in
+ * the first list of the last row. fl_bitmap has bit fl set when any
+ * list of that row is non-empty, and the row's byte in sl_bitmap has
+ * bit sl set when list (fl, sl) is, so both the mapping and the search
+ * for the next non-empty list are a few clz/ctz instructions. The heads
+ * count against the heap like any block, so the rows stop at
+ * 2^FL_SHIFT, past which blocks are few and their one list is searched
+ * for the best fit.
+ */
+#define SL_SHIFT    2
+#define SL_COUNT    (1 << SL_SHIFT)
+#define SMALL_SHIFT (SL_SHIFT + 3)
+#define SMALL_SIZE  (1 << SMALL_SHIFT)
+#define FL_SHIFT    14
+#define FL_COUNT    (FL_SHIFT - SMALL_SHIFT + 3)  /* row 0, 2^5 .. 2^14, big */
+#define NUM_LISTS   (FL_COUNT * SL_COUNT)
+
+/*
+ * Slabs. A request of at most SLAB_MAX bytes whose header would round
+ * it up by a double word can get a slot in a slab instead: an allocated
+ * block of SLAB_PAGE bytes aligned to SLAB_PAGE, holding a slab_t and
+ * then slots of one multiple of 8 bytes, with no header of their own. A
+ * slab's slot size, and from it the slot index, is found by masking the
+ * slot address. Each arena keeps a list of the slabs of each class that
+ * have a free slot. slab_map has a bit for each page of the heap that
+ * starts a slab, which is how free tells slots from blocks.
+ *
+ * A page costs as much as the slots it holds, so a class only gets one
+ * once the arena has live objects enough to fill it, counted in live;
+ * before that its requests get blocks, marked with SMALL_BIT so that
+ * free can count them out again. An empty slab goes back to the free
+ * lists, and the class to blocks when it was the last.
+ */
+#define SLAB_SHIFT   9
+#define SLAB_PAGE    (1 << SLAB_SHIFT)
+#define SLAB_MAX     64
+#define SLAB_CLASSES (SLAB_MAX / DSIZE)
+#define SLAB_WORDS   ((SLAB_PAGE / DSIZE + 31) / 32)
+#define SMALL_BIT    0x4    /* header bit of a block standing in for a slot */
+
+typedef struct {
+	offset_t next, prev;               /* slabs of the class with room */
+	unsigned short size;               /* slot size */
+	unsigned short nslots, nfree;
+	unsigned short first;              /* offset of slot 0 */
+	unsigned int free_map[SLAB_WORDS]; /* bit set: slot is free */
+} slab_t;
+
+#define SLAB_OF(bp)  ((slab_t *)((size_t)(bp) & ~(size_t)(SLAB_PAGE - 1)))
+#define SLAB_CLASS(size) ((size) / DSIZE - 1)
+#define SLAB_SLOTS(size) \
+	((SLAB_PAGE - WSIZE - ALIGN(sizeof(slab_t))) / (size))
+
+/*
+ * An arena is one set of free lists with the blocks they hold. The
+ * arenas sit at the start of the heap, below the prologue, and offset 0
+ * is kept free to end the lists. The heap of an arena is made of
+ * segments, each fenced by a prologue and an epilogue; top is the
+ * epilogue of the newest, which grows in place while nothing else has
+ * taken the memory above it. The default build has a single arena whose
+ * heap is all one segment.
+ */
+typedef struct {
+	offset_t heads[NUM_LISTS];         /* first block of each list */
+	unsigned int fl_bitmap;
+	offset_t top;                      /* the newest epilogue */
+	unsigned char sl_bitmap[FL_COUNT];
+	offset_t slabs[SLAB_CLASSES];      /* first slab with a free slot */
+	unsigned int live[SLAB_CLASSES];   /* slots and marked blocks in use */
+#ifdef MM_THREADS
+	pthread_mutex_t lock;
+	offset_t remote;                   /* blocks freed by other threads */
+	int nthreads;                      /* threads allocating from it */
+#endif
+} arena_t;
+
+#ifdef MM_THREADS
+#define MAX_ARENAS  8
+#define CHUNK_SHIFT 16
+#define ARENA_CHUNK (1 << CHUNK_SHIFT)
+#define NUM_CHUNKS  ((1L << HEAP_SHIFT) >> CHUNK_SHIFT)
+#define SLAB_MAP_SIZE (((1L << HEAP_SHIFT) >> SLAB_SHIFT) / 8)
+#else
+#define MAX_ARENAS  1
+#define NUM_CHUNKS  0
+#define SLAB_MAP_SIZE 0     /* grown on demand in a block of its own */
+#endif
 
+/* Bytes before the first segment: the null offset padded to a double
+   word, the arenas, the owner of each chunk and the slab map */
+#define PRELUDE_SIZE \
+	ALIGN(DSIZE + MAX_ARENAS * sizeof(arena_t) + NUM_CHUNKS + SLAB_MAP_SIZE)
+
+#define LIST_HEAD(a, fl, sl) ((char *)&(a)->heads[(fl) * SL_COUNT + (sl)])
 
 /* Global variables */
 static char *heap_listp = 0;  /* Pointer to first block */  
 static char *start_of_heap = 0;
 static char *list_heads_end = 0;
-static char *first_head = 0;
+static arena_t *arenas = 0;
+static unsigned char *slab_map = 0;
+static size_t slab_map_pages = 0;   /* pages slab_map has room for */
 /* Function prototypes for internal helper routines */
-static void *extend_heap(size_t words);
-static void place(void *bp, size_t asize);
-static void *find_fit(size_t asize);
-static void *coalesce(void *bp);
-
-/*the next_ptr of last block in the list point 0*/
-/*select the list for the size*/
-void *select_list(size_t size){
-	/*size >= 4096*/
-	if(size>>12){
-		return (void*)(ADR_RECV(WSIZE*13));
-	}
-	if(size>>11){
-		return (void*)(ADR_RECV(WSIZE*12));
-	}
-	if(size>>10){
-		return (void*)(ADR_RECV(WSIZE*11));
-	}
-	if(size>>9){
-		return (void*)(ADR_RECV(WSIZE*10));
-	}
-	if(size>>8){
-		return (void*)(ADR_RECV(WSIZE*9));
-	}
-	if(size>>7){
-		return (void*)(ADR_RECV(WSIZE*8));
-	}
-	if(size>>6){
-		return (void*)(ADR_RECV(WSIZE*7));
-	}
-	if(size>>5){
-		return (void*)(ADR_RECV(WSIZE*6));
-	}
-	if(size>>4){
-		return (void*)(ADR_RECV(WSIZE*5));
+static void *extend_heap(arena_t *a, size_t words);
+static void place(arena_t *a, void *bp, size_t asize);
+static void *find_fit(arena_t *a, size_t asize);
+static void *coalesce(arena_t *a, void *bp);
+static void *arena_malloc(arena_t *a, size_t asize);
+static void free_block(arena_t *a, void *bp);
+static int arena_resize(arena_t *a, void *bp, size_t asize);
+static void *small_alloc(arena_t *a, size_t size);
+static void slab_free(arena_t *a, void *bp);
+#ifdef MM_THREADS
+static void threads_init(void);
+static void *thread_malloc(size_t asize, int slot);
+static void thread_free(void *bp);
+static int thread_resize(void *bp, size_t asize);
+static unsigned char *chunk_owner = 0;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*index of the highest set bit of x, x != 0*/
+static inline int fls_bit(size_t x){
+	return 8 * sizeof(unsigned long) - 1 - __builtin_clzl(x);
+}
+
+/*the list a free block of this size belongs in*/
+static inline void mapping_insert(size_t size, int *fl, int *sl){
+	if(size < SMALL_SIZE){
+		*fl = 0;
+		*sl = size >> 3;
 	}
-	if(size>>3){
-		return (void*)(ADR_RECV(WSIZE*4));
+	else if(size >> (FL_SHIFT + 1)){
+		*fl = FL_COUNT - 1;
+		*sl = 0;
 	}
-	if(size>>2){
-		return (void*)(ADR_RECV(WSIZE*3));
+	else{
+		int l = fls_bit(size);
+		*fl = l - SMALL_SHIFT + 1;
+		*sl = (size >> (l - SL_SHIFT)) & (SL_COUNT - 1);
 	}
-	if(size>>1){
-		return (void*)(ADR_RECV(WSIZE*2));
+}
+
+/*the next non-empty list at or after (fl, sl), NULL if there is none*/
+static inline char *next_list(arena_t *a, int fl, int sl){
+	unsigned int map;
+	if(fl >= FL_COUNT)
+		return NULL;
+	map = a->sl_bitmap[fl] & (~0U << sl);
+	if(!map){
+		map = a->fl_bitmap & (~0U << (fl + 1));
+		if(!map)
+			return NULL;
+		fl = __builtin_ctz(map);
+		map = a->sl_bitmap[fl];
 	}
-	return (void*)(ADR_RECV(WSIZE));
+	return LIST_HEAD(a, fl, __builtin_ctz(map));
 }
 
-/*insert block into list, LIFO*/
-void insert_block(void *head, void *bp){
+/*insert block into its list, LIFO*/
+void insert_block(arena_t *a, void *bp){
+	int fl, sl;
+	mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+	char *head = LIST_HEAD(a, fl, sl);
 	void* next = NEXT_FREE(head);
 	PUT(NEXT_PTR(bp), GET(head));
-	PUT(PREV_PTR(bp), head);
+	PUT(PREV_PTR(bp), ADR_CAST(head));
 	PUT(NEXT_PTR(head), ADR_CAST(bp));
 	if(next != start_of_heap) 
 		PUT(PREV_PTR(next), ADR_CAST(bp));
-}
-/*find free block*/
-void *find_block(void *head, size_t size){
-	void *bp = ADR_RECV(GET(head));
-	while(bp != start_of_heap){
-		if(size <= GET_SIZE(HDRP(bp))){
-			return bp;
-		}
-		bp = NEXT_FREE(bp);
-	}
-	return NULL;
+	a->sl_bitmap[fl] |= 1U << sl;
+	a->fl_bitmap |= 1U << fl;
 }
 /*delete free block*/
-void delete_block(void* bp){
+void delete_block(arena_t *a, void* bp){
 	void *prev = PREV_FREE(bp), *next = NEXT_FREE(bp);
-	PUT(NEXT_PTR(prev), next);
+	PUT(NEXT_PTR(prev), ADR_CAST(next));
 	/*if bp is not last block*/
 	if(next != start_of_heap){
-		PUT(PREV_PTR(next), prev);
+		PUT(PREV_PTR(next), ADR_CAST(prev));
+	}
+	/*if bp was the only block, its list is now empty*/
+	else if((char *)prev < list_heads_end){
+		int i = (offset_t *)prev - a->heads;
+		int fl = i >> SL_SHIFT;
+		a->sl_bitmap[fl] &= ~(1U << (i & (SL_COUNT - 1)));
+		if(!a->sl_bitmap[fl])
+			a->fl_bitmap &= ~(1U << fl);
+	}
+}
+
+/*whether bp is a slot, rather than a block*/
+static inline int is_slab(void *bp){
+	size_t page = ADR_CAST(bp) >> SLAB_SHIFT;
+	return page < slab_map_pages && (slab_map[page >> 3] >> (page & 7)) & 1;
+}
+
+/*bytes of payload in bp: a whole slot, or a block less its header*/
+static inline size_t payload_size(void *bp){
+	return is_slab(bp) ? SLAB_OF(bp)->size : GET_SIZE(HDRP(bp)) - WSIZE;
+}
+
+/*take marked block bp of arena a out of the live count of its class*/
+static inline void small_unmark(arena_t *a, void *bp){
+	if(GET(HDRP(bp)) & SMALL_BIT){
+		PUT(HDRP(bp), GET(HDRP(bp)) & ~SMALL_BIT);
+		a->live[SLAB_CLASS(GET_SIZE(HDRP(bp)) - DSIZE)]--;
+	}
+}
+
+/*return bp to arena a, whether block or slot*/
+static inline void arena_free(arena_t *a, void *bp){
+	if(is_slab(bp))
+		slab_free(a, bp);
+	else{
+		small_unmark(a, bp);
+		free_block(a, bp);
 	}
 }
-/* 
+/*
  * mm_init - Initialize the memory manager 
  */
 int mm_init(void) 
 {
     /* Create the initial empty heap */
-    if ((heap_listp = mem_sbrk(18*WSIZE)) == (void *)-1) 
+    if ((start_of_heap = mem_sbrk(PRELUDE_SIZE + 2*DSIZE)) == (void *)-1)
         return -1;
-    start_of_heap = heap_listp;
-    first_head = heap_listp + WSIZE;
-    list_heads_end = (void*)(ADR_RECV(WSIZE*14));
-    memset(start_of_heap, 0, WSIZE*15);
+    memset(start_of_heap, 0, PRELUDE_SIZE);
+    arenas = (arena_t *)(start_of_heap + DSIZE);
+    list_heads_end = (char *)(arenas + MAX_ARENAS);
+#ifdef MM_THREADS
+    chunk_owner = (unsigned char *)list_heads_end;
+    slab_map = chunk_owner + NUM_CHUNKS;
+    slab_map_pages = 8 * SLAB_MAP_SIZE;
+    threads_init();
+#else
+    slab_map = NULL;
+    slab_map_pages = 0;
+#endif
 
-    heap_listp += 16*WSIZE;
+    heap_listp = start_of_heap + PRELUDE_SIZE + DSIZE;
     PUT(HDRP(heap_listp), PACK(2*WSIZE, 1));            /* Prologue header */ 
-    PUT(FTRP(heap_listp), PACK(2*WSIZE, 1));            /* Prologue footer */
-    PUT(HDRP(heap_listp + 2*WSIZE), PACK(0, 1)); 	    /* Epilogue header */
+    PUT(HDRP(heap_listp + 2*WSIZE), PACK(0, 3)); 	    /* Epilogue header */
+    arenas->top = ADR_CAST(HDRP(heap_listp + 2*WSIZE));
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-    if (extend_heap(CHUNKSIZE/WSIZE) == NULL) 
+    if (extend_heap(arenas, CHUNKSIZE/WSIZE) == NULL)
         return -1;
     return 0;
 }
 
-/* 
+/*
  * malloc - Allocate a block with at least size bytes of payload 
  */
 void *malloc(size_t size) 
 {
 	size_t asize;      /* Adjusted block size */
-    size_t extendsize; /* Amount to extend heap if no fit */
-    char *bp;      
+	int slot;          /* Whether it comes from a slab */
 
     if (heap_listp == 0){
         mm_init();
@@ -202,29 +374,27 @@ void *malloc(size_t size)
     if (size == 0)
         return NULL;
 
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)                                          
-        asize = 2*DSIZE;                                        
+    /* Adjust block size to include overhead and alignment reqs.
+       Small requests whose header would cost a double word of its
+       own may take a slot of the size rounded up instead. */
+    if (size <= DSIZE)
+        asize = 2*DSIZE;
     else
         asize = DSIZE * ((size + (WSIZE) + (DSIZE-1)) / DSIZE); 
-    asize = MAX(asize, 4*WSIZE);
+    slot = size <= SLAB_MAX && ALIGN(size) < asize;
+    if (slot)
+        asize = ALIGN(size);
 
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {  
-        place(bp, asize);
-        return bp;
-    }
-
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);                 
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL)  
-        return NULL;                                  
-    place(bp, asize);  
-    SET_NEXT_ALLOC(bp);                         
-    return bp;
-} 
+#ifdef MM_THREADS
+    return thread_malloc(asize, slot);
+#else
+    if (slot)
+        return small_alloc(arenas, asize);
+    return arena_malloc(arenas, asize);
+#endif
+}
 
-/* 
+/*
  * free - Free a block 
  */
 void free(void *bp)
@@ -234,27 +404,21 @@ void free(void *bp)
     if (heap_listp == 0){
         mm_init();
     }
-    size_t size = GET_SIZE(HDRP(bp)), vsize;
-    size_t prev_alloc = GET_PREV_ALLOC(bp);
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
-    SET_PREV_ALLOC(bp, prev_alloc);
-    SET_NEXT_ALLOC(heap_listp);
-    bp = coalesce(bp);
-    size = GET_SIZE(HDRP(bp));
-    vsize = size - DSIZE;
-    char *head = select_list(vsize);    
-    insert_block(head, bp);
-    SET_NEXT_UNALLOC(bp);
+#ifdef MM_THREADS
+    thread_free(bp);
+#else
+    arena_free(arenas, bp);
+#endif
 }
 
 /*
- * realloc - Naive implementation of realloc
+ * realloc - Resize in place where possible, else move the block
  */
 void *realloc(void *ptr, size_t size)
 {
-    size_t oldsize;
+    size_t oldsize, asize;
     void *newptr;
+    int done;
 
     /* If size == 0 then this is just free, and we return NULL. */
     if(size == 0) {
@@ -267,6 +431,25 @@ void *realloc(void *ptr, size_t size)
         return mm_malloc(size);
     }
 
+    /* A slot stays put while the new size fits in it */
+    if (is_slab(ptr)) {
+        if (size <= SLAB_OF(ptr)->size)
+            return ptr;
+    }
+    else {
+        if (size <= DSIZE)
+            asize = 2*DSIZE;
+        else
+            asize = DSIZE * ((size + (WSIZE) + (DSIZE-1)) / DSIZE);
+#ifdef MM_THREADS
+        done = thread_resize(ptr, asize);
+#else
+        done = arena_resize(arenas, ptr, asize);
+#endif
+        if (done)
+            return ptr;
+    }
+
     newptr = mm_malloc(size);
 
     /* If realloc() fails the original block is left untouched  */
@@ -275,7 +458,7 @@ void *realloc(void *ptr, size_t size)
     }
 
     /* Copy the old data. */
-    oldsize = GET_SIZE(HDRP(ptr));
+    oldsize = payload_size(ptr);
     if(size < oldsize) oldsize = size;
     memcpy(newptr, ptr, oldsize);
 
@@ -285,18 +468,26 @@ void *realloc(void *ptr, size_t size)
     return newptr;
 }
 
-/* 
+/*
  * mm_checkheap - Check the heap for correctness. Helpful hint: You
  *                can call this function using mm_checkheap(__LINE__);
  *                to identify the line number of the call site.
  */
 void mm_checkheap(int lineno)  
-{ 
+{
+	arena_t *a;
 	char* head;
 	int i;
-	for(head = first_head, i = 1; 
-        head<=list_heads_end; head += WSIZE, i++){
+	for(a = arenas; a < arenas + MAX_ARENAS; a++){
+	  for(i = 0; i < NUM_LISTS; i++){
+	    head = LIST_HEAD(a, 0, i);
 	    char* ptr = head;
+	    /*the bitmaps must agree with the list*/
+	    int fl = i >> SL_SHIFT, sl = i & (SL_COUNT - 1);
+	    if((GET(head) != 0) != ((a->sl_bitmap[fl] >> sl) & 1)
+	        || (a->sl_bitmap[fl] != 0) != ((a->fl_bitmap >> fl) & 1)){
+	    	exit(0);
+	    }
 	    if(GET(head) != 0){
 		    while(ptr != start_of_heap){
 		    	if(ptr != head && GET_ALLOC(HDRP(ptr))){
@@ -306,42 +497,180 @@ void mm_checkheap(int lineno)
                     && ptr != PREV_FREE(NEXT_FREE(ptr))){
 		    		exit(0);
 		    	}
+#ifdef MM_THREADS
+		    	/*and every block in it must be the arena's own*/
+		    	if(ptr != head && arenas
+                    + chunk_owner[ADR_CAST(ptr) >> CHUNK_SHIFT] != a){
+		    		exit(0);
+		    	}
+#endif
 		    	ptr = NEXT_FREE(ptr);
 		    }
 		}
+	  }
+	  /*a listed slab must be in the map and have the free slots it says*/
+	  for(i = 0; i < SLAB_CLASSES; i++){
+	    slab_t *s;
+	    offset_t off;
+	    int j, n;
+	    for(off = a->slabs[i]; off; off = s->next){
+	    	s = (slab_t *)ADR_RECV(off);
+	    	if(!is_slab(s) || SLAB_CLASS(s->size) != i || s->nfree == 0){
+	    		exit(0);
+	    	}
+	    	for(j = n = 0; j < SLAB_WORDS; j++)
+	    		n += __builtin_popcount(s->free_map[j]);
+	    	if(n != s->nfree){
+	    		exit(0);
+	    	}
+	    }
+	  }
 	}
 }
 
-/* 
+/*
  * The remaining routines are internal helper routines 
  */
 
-/* 
+/*
+ * arena_malloc - Allocate a block of asize bytes from arena a
+ */
+static void *arena_malloc(arena_t *a, size_t asize)
+{
+    size_t extendsize; /* Amount to extend heap if no fit */
+    char *bp;      
+
+    /* Search the free list for a fit */
+    if ((bp = find_fit(a, asize)) != NULL) {
+        place(a, bp, asize);
+        return bp;
+    }
+
+    /* No fit found. Get more memory and place the block */
+    extendsize = MAX(asize,CHUNKSIZE);                 
+    if ((bp = extend_heap(a, extendsize/WSIZE)) == NULL)
+        return NULL;
+    place(a, bp, asize);
+    SET_NEXT_ALLOC(bp);                         
+    return bp;
+}
+
+/*
+ * free_block - Return block bp to arena a, which it belongs to
+ */
+static void free_block(arena_t *a, void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(bp);
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    SET_PREV_ALLOC(bp, prev_alloc);
+    bp = coalesce(a, bp);
+    insert_block(a, bp);
+    SET_NEXT_UNALLOC(bp);
+}
+
+/*
+ * arena_resize - Resize block bp of arena a to asize bytes in place, by
+ *     splitting off its tail, taking in a free successor or growing the
+ *     heap under it; returns 0 if it cannot be done. Only the header is
+ *     written, so the payload survives.
+ */
+static int arena_resize(arena_t *a, void *bp, size_t asize)
+{
+    size_t csize;
+    /* Resized or moved, the block no longer stands in for a slot */
+    small_unmark(a, bp);
+    csize = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(bp);
+    char *next = NEXT_BLKP(bp);
+    size_t nsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+
+    if (asize > csize + nsize) {
+        /* Only the last block of the arena can grow the heap */
+        if (HDRP(next + nsize) != ADR_RECV(a->top))
+            return 0;
+        if (extend_heap(a, (asize - csize - nsize)/WSIZE) == NULL)
+            return 0;
+        /* extend_heap merged the new space with next, if it was free */
+        next = NEXT_BLKP(bp);
+        nsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+        if (asize > csize + nsize)
+            return 0; /* Another arena's memory lies above ours */
+    }
+    if (asize > csize) {
+        delete_block(a, next);
+        csize += nsize;
+        PUT(HDRP(bp), PACK(csize, 1));
+        SET_PREV_ALLOC(bp, prev_alloc);
+        SET_NEXT_ALLOC(bp);
+    }
+
+    /* Free the tail if it makes a block of its own */
+    if (csize - asize >= 2*DSIZE) {
+        PUT(HDRP(bp), PACK(asize, 1));
+        SET_PREV_ALLOC(bp, prev_alloc);
+        next = NEXT_BLKP(bp);
+        PUT(HDRP(next), PACK(csize - asize, 3));
+        free_block(a, next);
+    }
+    return 1;
+}
+
+/*
  * extend_heap - Extend heap with free block and return its block pointer
  */
  /*called by mm_init and malloc*/
-static void *extend_heap(size_t words) 
+static void *extend_heap(arena_t *a, size_t words)
 {
-    char *bp, *head;
-    size_t size, vsize;
+    char *bp;      
+    size_t size;
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE; 
     size = MAX(size, 4*WSIZE);
-    vsize = size - DSIZE;
+#ifdef MM_THREADS
+    /* While the arena's top is the end of the heap it grows in place.
+       Otherwise it starts a segment on the next chunk boundary, so that
+       every chunk has one owner, and takes whole chunks, fences
+       included, so as not to be back soon; the padding is lost. */
+    size_t brk, pad = 0;
+    pthread_mutex_lock(&heap_lock);
+    brk = mem_heapsize();
+    if (brk != a->top + WSIZE) {
+        pad = ((brk + ARENA_CHUNK - 1) & ~(ARENA_CHUNK - 1)) - brk;
+        size = (size + 2*DSIZE + ARENA_CHUNK - 1) & ~(ARENA_CHUNK - 1);
+    }
+    if ((long)(bp = mem_sbrk(pad + size)) != -1) {
+        bp += pad;
+        memset(chunk_owner + ((brk + ARENA_CHUNK - 1) >> CHUNK_SHIFT),
+               a - arenas, ((brk + pad + size - 1) >> CHUNK_SHIFT)
+               - ((brk + ARENA_CHUNK - 1) >> CHUNK_SHIFT) + 1);
+    }
+    pthread_mutex_unlock(&heap_lock);
+    if ((long)bp == -1)
+        return NULL;
+#else
     if ((long)(bp = mem_sbrk(size)) == -1)  
-        return NULL;                                        
-    
+        return NULL;
+#endif
+
+    /* Some other arena took the memory above ours: start a segment */
+    if (HDRP(bp) != ADR_RECV(a->top)) {
+        PUT(bp + WSIZE, PACK(DSIZE, 1));      /* Prologue header */
+        bp += 2*DSIZE;
+        size -= 2*DSIZE;
+        PUT(HDRP(bp), PACK(0, 3));            /* After an allocated block */
+    }
+
     /* Initialize free block header/footer and the epilogue header */
     size_t prev_alloc = GET_PREV_ALLOC(bp);
     PUT(HDRP(bp), PACK(size, 0));         /* Free block header */ 
     PUT(FTRP(bp), PACK(size, 0));
     SET_PREV_ALLOC(bp, prev_alloc);
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
-    SET_NEXT_ALLOC(heap_listp);
-    bp = coalesce(bp);                                          
-    vsize = GET_SIZE(HDRP(bp)) - DSIZE;
-   	head = select_list(vsize);
-   	insert_block(head, bp);
+    a->top = ADR_CAST(HDRP(NEXT_BLKP(bp)));
+    bp = coalesce(a, bp);
+   	insert_block(a, bp);
     return bp;
 }
 
@@ -349,11 +678,13 @@ static void *extend_heap(size_t words)
  * coalesce - Boundary tag coalescing. Return ptr to coalesced block
  */
  /*called by extend_heap and free*/
-static void *coalesce(void *bp) 
+static void *coalesce(arena_t *a, void *bp)
 {
-    char* prev = PREV_BLKP(bp);
-    char* next = NEXT_BLKP(bp);
     size_t prev_alloc = GET_PREV_ALLOC(bp);
+    /* An allocated predecessor has no footer to find it by, so prev is
+       only looked up in the cases that merge with it */
+    char* prev;
+    char* next = NEXT_BLKP(bp);
     size_t next_alloc = GET_ALLOC(HDRP(next));
     size_t size = GET_SIZE(HDRP(bp));
     if (prev_alloc && next_alloc) {            /* Case 1 */
@@ -361,17 +692,18 @@ static void *coalesce(void *bp)
     }
 
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
-    	delete_block(next);
+    	delete_block(a, next);
         size += GET_SIZE(HDRP(next));
         size_t prev_alloc = GET_PREV_ALLOC(bp);
 	    PUT(HDRP(bp), PACK(size, 0));
 	    PUT(FTRP(bp), PACK(size, 0));
 	    SET_PREV_ALLOC(bp, prev_alloc);
-        
+
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
-    	delete_block(prev);
+        prev = PREV_BLKP(bp);
+    	delete_block(a, prev);
         size += GET_SIZE(HDRP(prev));
         PUT(FTRP(bp), PACK(size, 0));
         size_t prev_prev_alloc = GET_PREV_ALLOC(prev);
@@ -381,8 +713,9 @@ static void *coalesce(void *bp)
     }
 
     else {                                     /* Case 4 */
-	    delete_block(next);
-    	delete_block(prev);
+        prev = PREV_BLKP(bp);
+	    delete_block(a, next);
+    	delete_block(a, prev);
         size += GET_SIZE(HDRP(prev)) + 
             GET_SIZE(FTRP(next));
         size_t prev_prev_alloc = GET_PREV_ALLOC(prev);
@@ -391,60 +724,511 @@ static void *coalesce(void *bp)
         PUT(FTRP(next), PACK(size, 0));
         bp = prev;
     }
-    SET_NEXT_ALLOC(heap_listp);
     //head = select_list(size);
     //insert_block(head, bp);
     return bp;
 }
 
-/* 
+/*
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
  */
  /*called by malloc*/
-static void place(void *bp, size_t asize)
+static void place(arena_t *a, void *bp, size_t asize)
 {
-    size_t csize = GET_SIZE(HDRP(bp)), vsize;
-    void *newbp, *head;
-    delete_block(bp);  
+    size_t csize = GET_SIZE(HDRP(bp));
+    void *newbp;
+    delete_block(a, bp);
     if ((csize - asize) >= (2*DSIZE)) { 
         size_t prev_alloc = GET_PREV_ALLOC(bp);
 	    PUT(HDRP(bp), PACK(asize, 1));
-	    PUT(FTRP(bp), PACK(asize, 1));
 	    SET_PREV_ALLOC(bp, prev_alloc);
         newbp = NEXT_BLKP(bp);
         PUT(HDRP(newbp), PACK(csize-asize, 0));
         PUT(FTRP(newbp), PACK(csize-asize, 0));
         SET_NEXT_ALLOC(bp);
-        vsize = csize - asize - DSIZE;
-        head = select_list(vsize);
-        insert_block(head, newbp);
+        insert_block(a, newbp);
     }
     else { 
         size_t prev_alloc = GET_PREV_ALLOC(bp);
 	    PUT(HDRP(bp), PACK(csize, 1));
-	    PUT(FTRP(bp), PACK(csize, 1));
 	    SET_PREV_ALLOC(bp, prev_alloc);
 	    SET_NEXT_ALLOC(bp);
     }
-    SET_NEXT_ALLOC(heap_listp);
 }
 
-/* 
+/*
  * find_fit - Find a fit for a block with asize bytes 
  */
 /*called by malloc*/
-static void *find_fit(size_t asize)
+static void *find_fit(arena_t *a, size_t asize)
+{
+    /* Good-fit search: the first block big enough in the list asize
+       maps to, or the smallest of the big blocks, else the first of
+       the next non-empty list, whose blocks all are big enough */
+    char *head, *bp, *best = NULL;
+    int fl, sl;
+    mapping_insert(asize, &fl, &sl);
+    for(bp = NEXT_FREE(LIST_HEAD(a, fl, sl)); bp != start_of_heap;
+        bp = NEXT_FREE(bp)){
+        if(asize > GET_SIZE(HDRP(bp)))
+            continue;
+        if(fl < FL_COUNT - 1)
+            return bp;
+        if(best == NULL || GET_SIZE(HDRP(bp)) < GET_SIZE(HDRP(best)))
+            best = bp;
+    }
+    if(fl == FL_COUNT - 1)
+        return best;
+    /* Lists after this one hold only blocks bigger than asize */
+    if(++sl == SL_COUNT){
+        sl = 0;
+        fl++;
+    }
+    if((head = next_list(a, fl, sl)) == NULL)
+        return NULL; /* No fit */
+    return NEXT_FREE(head);
+}
+
+/*
+ * slab_push - Put slab s on the list of its class in arena a
+ */
+static void slab_push(arena_t *a, slab_t *s)
+{
+	offset_t *head = &a->slabs[SLAB_CLASS(s->size)];
+	s->prev = 0;
+	s->next = *head;
+	if(*head)
+		((slab_t *)ADR_RECV(*head))->prev = ADR_CAST(s);
+	*head = ADR_CAST(s);
+}
+
+/*
+ * slab_unlink - Take slab s off the list of its class in arena a
+ */
+static void slab_unlink(arena_t *a, slab_t *s)
 {
-    /* First-fit search */
-    void *bp, *head;
-    for(head = select_list(asize); 
-        head <= (void*)list_heads_end; head += WSIZE){
-    	bp = find_block(head, asize);
-    	if(bp){
-    		return bp;
-    	}
+	if(s->prev)
+		((slab_t *)ADR_RECV(s->prev))->next = s->next;
+	else
+		a->slabs[SLAB_CLASS(s->size)] = s->next;
+	if(s->next)
+		((slab_t *)ADR_RECV(s->next))->prev = s->prev;
+}
+
+/*the first page boundary in free block bp a slab can start at, or NULL*/
+static inline char *slab_fit(char *bp){
+	char *p = (char *)(((size_t)bp + SLAB_PAGE - 1) & ~(size_t)(SLAB_PAGE - 1));
+	/* The part before the slab must be empty or a block */
+	if(p != bp && p - bp < 2*DSIZE)
+		p += SLAB_PAGE;
+	if(p + SLAB_PAGE > bp + GET_SIZE(HDRP(bp)))
+		return NULL;
+	return p;
+}
+
+/*
+ * slab_carve - Allocate the block at page p out of free block bp,
+ *     leaving what is before and after it free
+ */
+static char *slab_carve(arena_t *a, char *bp, char *p)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t lead = p - bp, tail = csize - lead - SLAB_PAGE;
+    size_t prev_alloc = GET_PREV_ALLOC(bp);
+    delete_block(a, bp);
+    if (lead) {
+        PUT(HDRP(bp), PACK(lead, 0));
+        PUT(FTRP(bp), PACK(lead, 0));
+        SET_PREV_ALLOC(bp, prev_alloc);
+        insert_block(a, bp);
+        prev_alloc = 0;
+    }
+    if (tail >= 2*DSIZE) {
+        PUT(HDRP(p), PACK(SLAB_PAGE, 1));
+        SET_PREV_ALLOC(p, prev_alloc);
+        bp = NEXT_BLKP(p);
+        PUT(HDRP(bp), PACK(tail, 0));
+        PUT(FTRP(bp), PACK(tail, 0));
+        SET_PREV_ALLOC(bp, 1);
+        insert_block(a, bp);
+    }
+    else {
+        /* Too little left for a block: the slab keeps it */
+        PUT(HDRP(p), PACK(SLAB_PAGE + tail, 1));
+        SET_PREV_ALLOC(p, prev_alloc);
+        SET_NEXT_ALLOC(p);
     }
-    return NULL; /* No fit */
+    return p;
+}
+
+/*
+ * slab_page - Allocate a block starting on a page boundary from arena
+ *     a, extending the heap if no free block has one far enough in
+ */
+static char *slab_page(arena_t *a)
+{
+	char *bp, *p;
+	int i, fl, sl;
+	mapping_insert(SLAB_PAGE, &fl, &sl);
+	for(i = fl * SL_COUNT + sl; i < NUM_LISTS; i++){
+		if(!((a->sl_bitmap[i >> SL_SHIFT] >> (i & (SL_COUNT - 1))) & 1))
+			continue;
+		for(bp = NEXT_FREE(LIST_HEAD(a, 0, i)); bp != start_of_heap;
+		    bp = NEXT_FREE(bp))
+			if((p = slab_fit(bp)) != NULL)
+				return slab_carve(a, bp, p);
+	}
+	/* Extend the heap just enough for a page to end at the new top,
+	   starting from the free block before the epilogue if there is
+	   one, as extend_heap will coalesce with it */
+	bp = ADR_RECV(a->top) + WSIZE;
+	if(!GET_PREV_ALLOC(bp))
+		bp -= GET_SIZE(bp - DSIZE);
+	p = (char *)(((size_t)bp + SLAB_PAGE - 1) & ~(size_t)(SLAB_PAGE - 1));
+	if(p != bp && p - bp < 2*DSIZE)
+		p += SLAB_PAGE;
+	if((bp = extend_heap(a, (p + SLAB_PAGE - ADR_RECV(a->top) - WSIZE)
+	                        / WSIZE)) == NULL)
+		return NULL;
+	return slab_carve(a, bp, slab_fit(bp));
+}
+
+#ifndef MM_THREADS
+/*
+ * slab_map_grow - Move slab_map to a block with room for page
+ */
+static int slab_map_grow(arena_t *a, size_t page)
+{
+	size_t pages = MAX(2 * slab_map_pages, (page + 64) & ~(size_t)63);
+	unsigned char *map;
+	map = arena_malloc(a, DSIZE * ((pages / 8 + WSIZE + DSIZE - 1) / DSIZE));
+	if(map == NULL)
+		return -1;
+	memset(map, 0, pages / 8);
+	if(slab_map != NULL){
+		memcpy(map, slab_map, slab_map_pages / 8);
+		free_block(a, slab_map);
+	}
+	slab_map = map;
+	slab_map_pages = pages;
+	return 0;
+}
+#endif
+
+/*
+ * slab_new - Make arena a a slab of slots of size bytes
+ */
+static slab_t *slab_new(arena_t *a, size_t size)
+{
+	slab_t *s;
+	size_t page;
+	int i;
+	if((s = (slab_t *)slab_page(a)) == NULL)
+		return NULL;
+	page = ADR_CAST(s) >> SLAB_SHIFT;
+#ifndef MM_THREADS
+	if(page >= slab_map_pages && slab_map_grow(a, page) < 0){
+		free_block(a, s);
+		return NULL;
+	}
+#endif
+	/* A map byte covers 8 pages of one chunk, so only its owner
+	   arena ever writes it */
+	slab_map[page >> 3] |= 1 << (page & 7);
+	s->size = size;
+	s->first = ALIGN(sizeof(slab_t));
+	s->nslots = s->nfree = SLAB_SLOTS(size);
+	memset(s->free_map, 0, sizeof(s->free_map));
+	for(i = 0; i < s->nslots; i++)
+		s->free_map[i >> 5] |= 1U << (i & 31);
+	slab_push(a, s);
+	return s;
+}
+
+/*
+ * slab_alloc - Allocate a slot of size bytes, a multiple of 8 up to
+ *     SLAB_MAX, from arena a
+ */
+static void *slab_alloc(arena_t *a, size_t size)
+{
+	slab_t *s;
+	unsigned int i, slot;
+	if(a->slabs[SLAB_CLASS(size)])
+		s = (slab_t *)ADR_RECV(a->slabs[SLAB_CLASS(size)]);
+	else if((s = slab_new(a, size)) == NULL)
+		return NULL;
+	for(i = 0; !s->free_map[i]; i++)
+		;
+	slot = __builtin_ctz(s->free_map[i]);
+	s->free_map[i] &= ~(1U << slot);
+	if(--s->nfree == 0)
+		slab_unlink(a, s);
+	return (char *)s + s->first + (i * 32 + slot) * size;
+}
+
+/*
+ * small_alloc - Allocate size bytes, a multiple of 8 up to SLAB_MAX,
+ *     from arena a: a slot while the class has a slab with room or live
+ *     objects enough to fill a new one, else a marked block
+ */
+static void *small_alloc(arena_t *a, size_t size)
+{
+	int c = SLAB_CLASS(size);
+	char *bp;
+	if(a->slabs[c] || a->live[c] >= SLAB_SLOTS(size)){
+		if((bp = slab_alloc(a, size)) != NULL)
+			a->live[c]++;
+		return bp;
+	}
+	if((bp = arena_malloc(a, size + DSIZE)) == NULL)
+		return NULL;
+	/* A block place did not split can be of another class's size */
+	if(GET_SIZE(HDRP(bp)) == size + DSIZE){
+		PUT(HDRP(bp), GET(HDRP(bp)) | SMALL_BIT);
+		a->live[c]++;
+	}
+	return bp;
+}
+
+/*
+ * slab_free - Free slot bp of arena a
+ */
+static void slab_free(arena_t *a, void *bp)
+{
+	slab_t *s = SLAB_OF(bp);
+	unsigned int slot = ((char *)bp - (char *)s - s->first) / s->size;
+	size_t page;
+	s->free_map[slot >> 5] |= 1U << (slot & 31);
+	a->live[SLAB_CLASS(s->size)]--;
+	if(s->nfree++ == 0)
+		slab_push(a, s);
+	/* Give an empty slab back */
+	else if(s->nfree == s->nslots){
+		page = ADR_CAST(s) >> SLAB_SHIFT;
+		slab_unlink(a, s);
+		slab_map[page >> 3] &= ~(1 << (page & 7));
+		free_block(a, s);
+	}
+}
+
+#ifdef MM_THREADS
+/*
+ * Thread-safe mode. Each thread allocates from one arena, chosen when
+ * it first calls malloc as the one with the fewest threads, so up to
+ * MAX_ARENAS threads never share a lock. Arenas grow by whole chunks
+ * and chunk_owner records which arena each chunk of the heap belongs
+ * to, so the owner of any block is one lookup away.
+ *
+ * A thread frees a block of its own arena under the arena lock. A
+ * block of another arena is pushed onto that arena's remote stack with
+ * a compare-and-swap instead, and the owner takes the whole stack at
+ * once and frees its blocks on its next malloc; since nothing but the
+ * owner ever pops, the stack has no ABA problem. Slots go the same way;
+ * a slab lies within one chunk, and its slab_map bit cannot change
+ * while one of its slots is allocated, so free reads it unlocked.
+ *
+ * In front of the arenas each thread keeps a tcache: for each slot size
+ * and each block size up to TCACHE_MAX a stack of up to TCACHE_COUNT
+ * slots or blocks it has freed, which malloc hands out again without
+ * taking any lock. The blocks stay allocated in their arena while they
+ * are cached, and go back to it when the thread exits. The tcache
+ * itself is allocated from the thread's arena, so as in the rest of
+ * mm.c no global arrays are needed. mm_init must not run while other
+ * threads use the heap.
+ */
+#define TCACHE_MAX   128
+#define TCACHE_BINS  (SLAB_CLASSES + TCACHE_MAX / DSIZE - 1)
+#define TCACHE_COUNT 8
+/* slots first, then blocks of 16, 24, .. TCACHE_MAX */
+#define TCACHE_BIN(size, slot) \
+	((slot) ? SLAB_CLASS(size) : SLAB_CLASSES + (size) / DSIZE - 2)
+
+typedef struct {
+	offset_t head[TCACHE_BINS];
+	unsigned char count[TCACHE_BINS];
+} tcache_t;
+
+static __thread arena_t *thread_arena = NULL;
+static __thread tcache_t *tcache = NULL;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_exit(void *unused);
+
+static void thread_key_create(void)
+{
+	pthread_key_create(&thread_key, thread_exit);
+}
+
+/*
+ * threads_init - Set up the arenas of a fresh heap; called by mm_init
+ */
+static void threads_init(void)
+{
+	int i;
+	pthread_once(&thread_key_once, thread_key_create);
+	for(i = 0; i < MAX_ARENAS; i++)
+		pthread_mutex_init(&arenas[i].lock, NULL);
+	thread_arena = NULL;
+	tcache = NULL;
+	pthread_setspecific(thread_key, NULL);
+}
+
+/*the arena block bp belongs to*/
+static inline arena_t *block_owner(void *bp){
+	return arenas + chunk_owner[ADR_CAST(bp) >> CHUNK_SHIFT];
+}
+
+/*
+ * remote_push - Hand block bp to its owner a from another thread
+ */
+static void remote_push(arena_t *a, void *bp)
+{
+	offset_t old = __atomic_load_n(&a->remote, __ATOMIC_RELAXED);
+	do {
+		PUT(NEXT_PTR(bp), old);
+	} while(!__atomic_compare_exchange_n(&a->remote, &old, ADR_CAST(bp),
+	        1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * remote_drain - Free the blocks other threads pushed onto arena a,
+ *     which the caller has locked
+ */
+static void remote_drain(arena_t *a)
+{
+	offset_t off;
+	char *bp;
+	if(!__atomic_load_n(&a->remote, __ATOMIC_RELAXED))
+		return;
+	off = __atomic_exchange_n(&a->remote, 0, __ATOMIC_ACQUIRE);
+	while(off){
+		bp = ADR_RECV(off);
+		off = GET(NEXT_PTR(bp));
+		arena_free(a, bp);
+	}
+}
+
+/*
+ * thread_attach - Give the calling thread an arena and a tcache
+ */
+static void thread_attach(void)
+{
+	arena_t *a, *best = arenas;
+	pthread_mutex_lock(&heap_lock);
+	for(a = arenas + 1; a < arenas + MAX_ARENAS; a++)
+		if(a->nthreads < best->nthreads)
+			best = a;
+	best->nthreads++;
+	pthread_mutex_unlock(&heap_lock);
+	thread_arena = best;
+
+	pthread_mutex_lock(&best->lock);
+	tcache = arena_malloc(best, ALIGN(sizeof(tcache_t) + DSIZE));
+	pthread_mutex_unlock(&best->lock);
+	if(tcache != NULL)
+		memset(tcache, 0, sizeof(tcache_t));
+	pthread_setspecific(thread_key, best);
+}
+
+/*
+ * thread_malloc - malloc for a thread, asize already adjusted and
+ *     slot set if it is to be a slot
+ */
+static void *thread_malloc(size_t asize, int slot)
+{
+	arena_t *a;
+	char *bp;
+	if(tcache != NULL && asize <= TCACHE_MAX){
+		int bin = TCACHE_BIN(asize, slot);
+		if(tcache->count[bin]){
+			bp = ADR_RECV(tcache->head[bin]);
+			tcache->head[bin] = GET(NEXT_PTR(bp));
+			tcache->count[bin]--;
+			return bp;
+		}
+	}
+	if(thread_arena == NULL)
+		thread_attach();
+	a = thread_arena;
+	pthread_mutex_lock(&a->lock);
+	remote_drain(a);
+	bp = slot ? small_alloc(a, asize) : arena_malloc(a, asize);
+	pthread_mutex_unlock(&a->lock);
+	return bp;
+}
+
+/*
+ * release - Give block bp back to the arena it came from
+ */
+static void release(void *bp)
+{
+	arena_t *a = block_owner(bp);
+	if(a != thread_arena){
+		remote_push(a, bp);
+		return;
+	}
+	pthread_mutex_lock(&a->lock);
+	arena_free(a, bp);
+	pthread_mutex_unlock(&a->lock);
 }
 
+/*
+ * thread_free - free for a thread
+ */
+static void thread_free(void *bp)
+{
+	int slot = is_slab(bp);
+	size_t size = slot ? SLAB_OF(bp)->size : GET_SIZE(HDRP(bp));
+	if(tcache != NULL && size <= TCACHE_MAX){
+		int bin = TCACHE_BIN(size, slot);
+		if(tcache->count[bin] < TCACHE_COUNT){
+			PUT(NEXT_PTR(bp), tcache->head[bin]);
+			tcache->head[bin] = ADR_CAST(bp);
+			tcache->count[bin]++;
+			return;
+		}
+	}
+	release(bp);
+}
+
+/*
+ * thread_resize - arena_resize for a thread, under the lock of the
+ *     arena bp belongs to, whichever thread that is
+ */
+static int thread_resize(void *bp, size_t asize)
+{
+	arena_t *a = block_owner(bp);
+	int done;
+	pthread_mutex_lock(&a->lock);
+	done = arena_resize(a, bp, asize);
+	pthread_mutex_unlock(&a->lock);
+	return done;
+}
+
+/*
+ * thread_exit - Flush the tcache of an exiting thread and leave its
+ *     arena to the next thread that needs one
+ */
+static void thread_exit(void *unused)
+{
+	tcache_t *tc = tcache;
+	char *bp;
+	int bin;
+	if(tc != NULL){
+		tcache = NULL;
+		for(bin = 0; bin < TCACHE_BINS; bin++)
+			while(tc->count[bin]--){
+				bp = ADR_RECV(tc->head[bin]);
+				tc->head[bin] = GET(NEXT_PTR(bp));
+				release(bp);
+			}
+		release(tc);
+	}
+	pthread_mutex_lock(&heap_lock);
+	thread_arena->nthreads--;
+	pthread_mutex_unlock(&heap_lock);
+	thread_arena = NULL;
+}
+#endif /* def MM_THREADS */